@@ -0,0 +1,9 @@
+#pragma once
+
+namespace obf {
+
+// finds every pair of bodies that could touch before next tick with a sweep over their reach along x,
+// then collides the ones that do one by one in a fixed order, needs bodies synced to updateGroup
+void collideBodies();
+
+}
@@ -1,6 +1,10 @@
 #pragma once
 #include "events.hpp"
+#include "handles.hpp"
 #include "math.hpp"
+#include "physics.hpp"
+#include "pools.hpp"
+#include "quadtree.hpp"
 
 #include <limits>
 #include <memory>
@@ -22,11 +26,9 @@ void generateSystem();
 
 void fullClear(bool clearTriangles);
 
+// advances every entity by delta with the configured integrator
 void updateEntities();
 
-void reallocateQuadtree();
-void buildQuadtree();
-
 struct movement {
 	int forward: 1 = 0;
 	int backward: 1 = 0;
@@ -45,7 +47,7 @@ struct Point {
 
 bool operator ==(movement& mov1, movement& mov2);
 
-struct Entity : EntityDeleteListener {
+struct Entity {
 	Entity();
 	virtual ~Entity() noexcept;
 
@@ -56,8 +58,6 @@ struct Entity : EntityDeleteListener {
 
 	virtual void collide(Entity* with, bool collideOther);
 
-	std::vector<uint32_t> collided;
-
 	void syncCreation();
 
 	virtual void loadCreatePacket(sf::Packet& packet) = 0;
@@ -65,24 +65,31 @@ struct Entity : EntityDeleteListener {
 	virtual void loadSyncPacket(sf::Packet& packet) = 0;
 	virtual void unloadSyncPacket(sf::Packet& packet) = 0;
 
-	virtual void simSetup();
-	virtual void simReset();
-
-	void onEntityDelete(Entity* d) override;
-
 	inline void setPosition(double x, double y) {
-		this->x = x;
-		this->y = y;
+		bodies.x[slot] = x;
+		bodies.y[slot] = y;
 	}
 	inline void setVelocity(double x, double y) {
-		velX = x;
-		velY = y;
+		bodies.velX[slot] = x;
+		bodies.velY[slot] = y;
 	}
 	inline void addVelocity(double dx, double dy) {
-		velX += dx;
-		velY += dy;
+		bodies.velX[slot] += dx;
+		bodies.velY[slot] += dy;
 	}
 
+	// kinematic state lives in the BodyStore, these only forward to our slot
+	inline double& x() { return bodies.x[slot]; }
+	inline double& y() { return bodies.y[slot]; }
+	inline double& velX() { return bodies.velX[slot]; }
+	inline double& velY() { return bodies.velY[slot]; }
+	inline double& dVelX() { return bodies.dVelX[slot]; } // exist for caching reasons
+	inline double& dVelY() { return bodies.dVelY[slot]; }
+	inline double& accX() { return bodies.accX[slot]; }
+	inline double& accY() { return bodies.accY[slot]; }
+	inline double& mass() { return bodies.mass[slot]; }
+	inline double& radius() { return bodies.radius[slot]; }
+
 	inline void setColor(uint8_t r, uint8_t g, uint8_t b) {
 		color[0] = r;
 		color[1] = g;
@@ -95,38 +102,23 @@ struct Entity : EntityDeleteListener {
 
 	virtual uint8_t type() = 0;
 	Player* player = nullptr;
-	double x = 0.0, y = 0.0, velX = 0.0, velY = 0.0, rotation = 0.0, rotateVel = 0.0,
-	dVelX = 0.0, dVelY = 0.0, // exist for caching reasons
-	radius = 0.0,
-	mass = 0.0,
-	resX = 0.0, resY = 0.0, resVelX = 0.0, resVelY = 0.0, resRotation = 0.0, resRotateVel = 0.0, resMass = 0.0, resRadius = 0.0,
+	uint32_t slot;
+	EntityRef handle;
+	double rotation = 0.0, rotateVel = 0.0,
 	syncX = 0.0, syncY = 0.0, syncVelX = 0.0, syncVelY = 0.0;
-	bool ghost = false, ai = false, synced = false, active = true;
-	Entity* simRelBody = nullptr;
+	bool ai = false, synced = false, active = true;
 	unsigned char color[3]{255, 255, 255};
-	uint32_t id, parent_id = std::numeric_limits<uint32_t>::max();
+	uint32_t id;
 };
 
 Entity* idLookup(uint32_t);
 
-struct Quad {
-	void collideAttract(Entity* e, bool, bool);
-	void put(Entity* e);
-	Quad& getChild(uint8_t at);
-	uint32_t unstaircasize();
-	void postBuild();
-
-	void draw();
-
-	uint32_t children[4] = {0, 0, 0, 0};
-	Entity* entity = nullptr;
-	double size, invsize, x, y, comx = 0.0, comy = 0.0, mass = 0.0;
-	bool used = false;
-};
-
 struct Triangle: public Entity {
 	Triangle();
 
+	static void* operator new(size_t) { return EntityPool<Triangle>::take(); }
+	static void operator delete(void* p) { EntityPool<Triangle>::give(p); }
+
 	void control(movement& cont) override;
 	void draw() override;
 
@@ -135,20 +127,14 @@ struct Triangle: public Entity {
 	void loadSyncPacket(sf::Packet& packet) override;
 	void unloadSyncPacket(sf::Packet& packet) override;
 
-	void simSetup() override;
-	void simReset() override;
-
-	void onEntityDelete(Entity* d) override;
-
 	uint8_t type() override;
 	double accel = 96, rotateSlowSpeedMult = 2.0 / 3.0, rotateSpeed = 180.0, boostCooldown = 12.0, boostStrength = 240, reload = 8.0, shootPower = 120, hyperboostStrength = 432, hyperboostTime = 20.0, hyperboostRotateSpeed = rotateSpeed * 0.02, afterburnStrength = 1080, minAfterburn = hyperboostTime + 8.0,
-	boostProgress = 0.0, reloadProgress = 0.0, hyperboostCharge = 0.0,
-	resBoostProgress = 0.0, resReloadProgress = 0.0, resHyperboostCharge = 0.0;
+	boostProgress = 0.0, reloadProgress = 0.0, hyperboostCharge = 0.0;
 
-	bool burning = false, resBurning;
+	bool burning = false;
 	std::string name = "unnamed";
 
-	Entity* target = nullptr;
+	EntityRef target;
 
 	std::unique_ptr<sf::CircleShape> shape, forwards;
 };
@@ -158,6 +144,9 @@ struct CelestialBody: public Entity {
 	CelestialBody(double radius, double mass);
 	CelestialBody(bool ghost);
 
+	static void* operator new(size_t) { return EntityPool<CelestialBody>::take(); }
+	static void operator delete(void* p) { EntityPool<CelestialBody>::give(p); }
+
 	void draw() override;
 
 	void collide(Entity* with, bool collideOther) override;
@@ -176,6 +165,10 @@ struct CelestialBody: public Entity {
 
 struct Projectile: public Entity {
 	Projectile();
+	~Projectile() noexcept;
+
+	static void* operator new(size_t) { return EntityPool<Projectile>::take(); }
+	static void operator delete(void* p) { EntityPool<Projectile>::give(p); }
 
 	void update2() override;
 
@@ -188,12 +181,12 @@ struct Projectile: public Entity {
 	void loadSyncPacket(sf::Packet& packet) override;
 	void unloadSyncPacket(sf::Packet& packet) override;
 
-	void onEntityDelete(Entity* d) override;
-
 	uint8_t type() override;
 
-	Entity* target = nullptr;
-	Entity* owner = nullptr;
+	void setTarget(Entity* e);
+
+	EntityRef target, owner;
+	std::vector<EntityRef> chasers; // projectiles that had this one set as target
 
 	double accel = 196, rotateSpeed = 240.0, maxThrustAngle = 45.0 * degToRad, easeInFactor = 0.8;
 
@@ -5,8 +5,6 @@
 
 namespace obf {
 
-struct Entity;
-
 struct KeyPressListener {
     inline KeyPressListener() {
         listeners.push_back(this);
@@ -45,25 +43,6 @@ struct TextEnteredListener {
     inline static std::vector<TextEnteredListener*> listeners;
 };
 
-struct EntityDeleteListener {
-    inline EntityDeleteListener() {
-        listeners.push_back(this);
-    }
-    inline ~EntityDeleteListener() {
-        for (size_t i = 0; i < listeners.size(); i++) {
-            if (listeners[i] == this) {
-                listeners[i] = listeners[listeners.size() - 1];
-                listeners.pop_back();
-                break;
-            }
-        }
-    }
-
-    virtual void onEntityDelete(Entity* d) = 0;
-
-    inline static std::vector<EntityDeleteListener*> listeners;
-};
-
 struct MousePressListener {
     inline MousePressListener() {
         listeners.push_back(this);
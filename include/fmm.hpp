@@ -0,0 +1,9 @@
+#pragma once
+
+namespace obf {
+
+// gravity for every body in the quadtree through a dual tree walk, quads far enough from each other interact as a whole
+// and their pull is carried down to the bodies as a linear field, collisions come from the broadphase in collideBodies()
+void fmmAttract();
+
+}
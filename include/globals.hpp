@@ -1,6 +1,7 @@
 #pragma once
 
 #include "entities.hpp"
+#include "threads.hpp"
 #include "types.hpp"
 #include "ui.hpp"
 
@@ -25,19 +26,25 @@ inline std::vector<Entity*> updateGroup;
 inline std::vector<Player*> playerGroup;
 inline std::vector<UIElement*> uiGroup;
 inline obf::MenuUI* menuUI = nullptr;
-inline std::vector<Entity*> simCleanupBuffer;
 inline std::vector<CelestialBody*> planets;
 inline std::vector<std::vector<Point>> ghostTrajectories;
 inline std::vector<sf::Color> ghostTrajectoryColors;
+inline std::vector<std::vector<Point>> spareTrajectories; // trajectory buffers of deleted entities, handed to new ones, at most one per live entity
+inline uint64_t trajectoriesReused = 0;
+inline uint64_t blockTick = 0; // ticks run, block timesteps start at multiples of their length
 inline sf::Vector2i mousePos;
 inline sf::Clock actualDeltaClock, deltaClock, globalClock;
 inline std::future<void> inputReader;
-inline std::vector<std::thread*> updateThreads;
-inline std::string serverAddress = "", name = "", inputBuffer = "";
+inline obf::ThreadPool* updatePool = nullptr;
+inline std::string serverAddress = "", name = "", inputBuffer = "",
+gravitySolver = "tree",
+integrator = "leapfrog",
+predictIntegrator = "leapfrog";
 inline unsigned short port = 7817;
 inline movement lastControls, controls;
 inline double delta = 1.0 / 60.0,
 	globalTime = 0.0,
+	simTime = 0.0, // game time simulated so far, every tick adds its delta
 	deltaOverride = -1.0, // disabled when < 0
 	timescale = 1.0,
 	maxAckTime = 15.0,
@@ -51,15 +58,19 @@ inline double delta = 1.0 / 60.0,
 	gen_minMoonRadius = 120.0, gen_maxMoonRadiusFrac = 1.0 / 6.0,
 	shipSpawnDistanceMin = 1.4, shipSpawnDistanceMax = 3.0,
 	syncCullThreshold = 0.6, syncCullOffset = 100000.0, sweepThreshold = 10e6 * 10e6,
-	predictSpacing = 0.25, predictDelta = 0.2,
-	extraQuadAllocation = 2.0, quadReallocateThreshold = 0.6, quadtreeShrinkThreshold = 0.2,
+	predictSpacing = 0.25, predictDelta = 0.2, predictTolerance = 100.0, predictRefresh = 10.0, predictAccuracy = 0.001, conicThreshold = 1e-4,
+	extraQuadAllocation = 2.0, quadtreeShrinkThreshold = 0.2,
 	autorestartSpacing = 30.0 * 60.0 + 1, autorestartNotifSpacing = 5.0 * 60.0,
 	G = 6.67e-11,
 	gravityAccuracy = 5.0,
+	testParticleMassRatio = 1e-12,
+	quadtreeRefitLimit = 1.5,
+	blockAccuracy = 0.02,
+	farFieldAccuracy = 2.0,
 	targetFramerate = 90.0,
-	lastPing = 0.0, lastPredict = 0.0, lastSweep = 0.0, lastAutorestartNotif = -autorestartNotifSpacing, lastAutorestart = 0.0,
+	lastPing = 0.0, lastPredict = 0.0, predictedFrom = 0.0, lastSweep = 0.0, lastAutorestartNotif = -autorestartNotifSpacing, lastAutorestart = 0.0,
 	lastShowFramerate = 0.0,
-	predictingFor = 0.0,
+	physicsRate = 60.0, tickAccumulator = 0.0,
 	drawShiftX = 0.0, drawShiftY = 0.0,
 	ownX = 0.0, ownY = 0.0;
 inline int textCharacterSize = 18,
@@ -68,7 +79,11 @@ predictSteps = (int)(90.0 / predictDelta),
 gen_baseMinPlanets = 10,
 gen_baseMaxPlanets = 15,
 quadsConstructed = 100, minQuadtreeSize = 80,
-quadsAllocated = (int)(quadsConstructed * extraQuadAllocation),
+quadtreeBucketSize = 16,
+maxTicksPerFrame = 4,
+blockLevels = 6,
+farFieldInterval = 4,
+quadtreeShrinkDelay = 600, // builds in a row the quadtree has to stay small for before its memory is released
 updateThreadCount = 1;
 inline size_t minThreadEntities = 100,
 messageLimit = 50, usernameLimit = 24;
@@ -78,11 +93,15 @@ inline bool headless = false, isServer = false, authority = false, autoConnect =
 inputWaiting = false, lockControls = false,
 handledTextBoxSelect = false,
 enableControlLock = false,
-simulating = false,
+gravityQuadrupoles = false,
+reducedPrediction = false,
+quadtreeRefit = true,
+autoDirectGravity = false,
 autorestartRegenned = true,
 printPlanetMerges = true;
 
-inline obf::Quad* quadtree = (Quad*)malloc((size_t)(sizeof(Quad) * quadsAllocated));
+inline obf::QuadArena quadtree;
+inline std::vector<uint32_t> quadtreeBodies; // BodyStore slots of the bodies in the quadtree in Morton order, quads refer to ranges of this
 
 struct Var {
 	uint8_t type;
@@ -99,6 +118,12 @@ inline std::map<std::string, Var> vars {
 	{"predictDelta", {Double, &predictDelta}},
 	{"predictSpacing", {Double, &predictSpacing}},
 	{"predictSteps", {Int, &predictSteps}},
+	{"predictTolerance", {Double, &predictTolerance}},
+	{"predictRefresh", {Double, &predictRefresh}},
+	{"predictIntegrator", {String, &predictIntegrator}},
+	{"predictAccuracy", {Double, &predictAccuracy}},
+	{"conicThreshold", {Double, &conicThreshold}},
+	{"reducedPrediction", {Bool, &reducedPrediction}},
 
 	{"autoConnect", {Bool, &autoConnect}},
 	{"DEBUG", {Bool, &debug}},
@@ -119,11 +144,26 @@ inline std::map<std::string, Var> vars {
 	{"sweepThreshold", {Double, &sweepThreshold}},
 
 	{"gravityAccuracy", {Double, &gravityAccuracy}},
+	{"gravitySolver", {String, &gravitySolver}},
+	{"autoDirectGravity", {Bool, &autoDirectGravity}},
+	{"integrator", {String, &integrator}},
+	{"blockLevels", {Int, &blockLevels}},
+	{"blockAccuracy", {Double, &blockAccuracy}},
+	{"farFieldInterval", {Int, &farFieldInterval}},
+	{"farFieldAccuracy", {Double, &farFieldAccuracy}},
+	{"quadtreeBucketSize", {Int, &quadtreeBucketSize}},
+	{"gravityQuadrupoles", {Bool, &gravityQuadrupoles}},
+	{"testParticleMassRatio", {Double, &testParticleMassRatio}},
+	{"quadtreeRefit", {Bool, &quadtreeRefit}},
+	{"quadtreeRefitLimit", {Double, &quadtreeRefitLimit}},
+	{"quadtreeShrinkDelay", {Int, &quadtreeShrinkDelay}},
 
 	{"friction", {Double, &friction}},
 	{"collideRestitution", {Double, &collideRestitution}},
 	{"gravityStrength", {Double, &G}},
 
+	{"physicsRate", {Double, &physicsRate}},
+	{"maxTicksPerFrame", {Int, &maxTicksPerFrame}},
 	{"deltaOverride", {Double, &deltaOverride}},
 	{"timescale", {Double, &timescale}},
 
@@ -148,8 +188,8 @@ inline std::map<std::string, Var> vars {
 	{"gen_starRadius", {Double, &gen_starRadius}}};
 
 inline std::vector<CelestialBody*> stars;
-inline Entity* trajectoryRef = nullptr;
-inline Entity* lastTrajectoryRef = nullptr;
+inline EntityRef trajectoryRef;
+inline EntityRef lastTrajectoryRef;
 inline Entity* systemCenter = nullptr;
 
 inline const std::string configFile = "config.txt", configDocFile = "confighelp.txt";
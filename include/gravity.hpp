@@ -0,0 +1,10 @@
+#pragma once
+
+namespace obf {
+
+// finds the gravity on every due body, with a direct sum over every pair when that's measured to be faster than gravitySolver
+void findGravity();
+// prints what findGravity() measured each way takes and which one it's using
+void printGravityStats();
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace obf {
+
+struct Entity;
+
+// weak reference to an entity, reads as nullptr once the entity has been deleted
+struct EntityRef {
+	EntityRef() = default;
+	EntityRef(Entity* e);
+
+	Entity* get() const;
+	inline operator Entity*() const { return get(); }
+	inline Entity* operator->() const { return get(); }
+
+	uint32_t index = std::numeric_limits<uint32_t>::max(), generation = 0;
+};
+
+// every live entity by handle index, a freed index gets its generation bumped so old refs to it stop resolving
+struct EntityTable {
+	EntityRef add(Entity* e);
+	void remove(EntityRef ref);
+	void changeId(Entity* e, uint32_t oldId); // entities made from packets take the server's id after construction
+
+	Entity* byId(uint32_t id) const;
+
+	std::vector<Entity*> entities;
+	std::vector<uint32_t> generations, freeIndices;
+	std::unordered_map<uint32_t, uint32_t> ids; // entity id to index
+};
+
+inline EntityTable entityTable;
+
+}
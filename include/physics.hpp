@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace obf {
+
+struct Entity;
+
+// kinematic state of every entity, stored contiguously and indexed by Entity::slot
+// after syncBodies() slot i belongs to updateGroup[i], so physics loops can walk the arrays directly
+struct BodyStore {
+	uint32_t add(Entity* owner);
+	void remove(uint32_t slot); // moves the last body into the freed slot
+	void swap(uint32_t a, uint32_t b);
+
+	size_t size() const;
+
+	std::vector<double> x, y, velX, velY, dVelX, dVelY, mass, radius;
+	std::vector<double> accX, accY; // gravity at the positions of the last attractLeaves(), kept between ticks for the integrators that start with a kick
+	std::vector<uint8_t> level; // gravity is found and applied every 2^level ticks, unsetLevel until a body's gravity is first found
+	std::vector<uint8_t> due; // whether the body's block ends at the tick markDueBodies() was last called for
+	std::vector<double> farAccX, farAccY; // part of acc from quads in the far field, see farFieldInterval
+	std::vector<uint64_t> farTick; // blockTick farAcc was found at
+	std::vector<Entity*> owner;
+	uint64_t generation = 0; // bumped by every add and remove, the same value means the same bodies even if their addresses were reused
+};
+
+constexpr uint8_t unsetLevel = 255;
+
+inline BodyStore bodies;
+
+// reorders the store so that slots match updateGroup order, cheap when nothing changed
+void syncBodies();
+// drifts slots [from, to) by their velocity over step, dVel is left as the distance moved
+void moveBodies(size_t from, size_t to, double step);
+// flags the slots in [from, to) whose block of 2^level ticks starts at tick, bodies without a level are always due
+void markDueBodies(size_t from, size_t to, uint64_t tick);
+// adds their gravity over step * 2^level to the velocity of due slots in [from, to)
+void kickBodies(size_t from, size_t to, double step);
+// picks the next level of due slots in [from, to) from how quickly gravity turns their velocity, up to maxLevel
+// a level only goes up by one at a time and only where tick also starts the longer block, so blocks stay nested
+void levelBodies(size_t from, size_t to, double step, uint64_t tick, int maxLevel);
+// drifts every body by fraction of a tick of length tickDelta for drawing, restoreBodies() puts them back exactly
+void interpolateBodies(double fraction, double tickDelta);
+void restoreBodies();
+
+// adds mass * (x - px) / dist^3 of every point in the list to ax and ay, points at distance 0 are skipped
+// uses AVX2 or SSE2 when the cpu has them, picked on first call
+void sumAttraction(const double* x, const double* y, const double* mass, size_t count, double px, double py, double& ax, double& ay);
+// adds the quadrupole part of the pull of point masses at x, y with moments qxx, qxy, qyy about them
+void sumQuadrupoles(const double* x, const double* y, const double* qxx, const double* qxy, const double* qyy, size_t count, double px, double py, double& ax, double& ay);
+
+}
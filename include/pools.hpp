@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace obf {
+
+// recycles storage of one entity type, projectiles come and go every few ticks
+// storage is allocated in chunks and never given back, entities are only created and deleted on the main thread
+// types take it through their own operator new and delete, which delete through Entity* still reaches thanks to the virtual destructor
+template <typename T>
+struct EntityPool {
+	static constexpr size_t chunkSize = 64;
+
+	static void* take() {
+		if (spare.empty()) [[unlikely]] {
+			char* chunk = (char*)::operator new(sizeof(T) * chunkSize);
+			for (size_t i = chunkSize; i > 0; i--) {
+				spare.push_back(chunk + (i - 1) * sizeof(T));
+			}
+			chunks++;
+		} else {
+			reused++;
+		}
+		void* p = spare.back();
+		spare.pop_back();
+		live++;
+		return p;
+	}
+	static void give(void* p) {
+		spare.push_back(p);
+		live--;
+	}
+
+	inline static std::vector<void*> spare;
+	inline static uint64_t chunks = 0, reused = 0, live = 0;
+};
+
+// prints and resets how much entity storage came from the pools
+void printPoolStats();
+
+}
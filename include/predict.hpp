@@ -0,0 +1,12 @@
+#pragma once
+
+namespace obf {
+
+// copies the bodies and starts predicting their trajectories on a worker thread, does nothing if one is still running
+void startPrediction();
+// hands the trajectories of a finished prediction to the entities and ghostTrajectories, never waits on the worker
+void collectPrediction();
+// prints and resets how many steps predictions took
+void printPredictionStats();
+
+}
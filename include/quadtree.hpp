@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace obf {
+
+// linear quadtree over the massive bodies of updateGroup built from Z-order (Morton) keys, children of a node are always stored after it
+void buildQuadtree();
+// finds the gravity on every due body (see markDueBodies()) and stores it in bodies.accX/accY, walking the tree once per leaf or group of test particles and sharing the result between the group's bodies
+void attractLeaves();
+// prints and resets how many quads the leaf walks visited
+void printQuadtreeStats();
+// prints how far the gravity with the cached far field is from finding all of it now
+void printFarFieldError();
+
+struct Quad {
+	void draw();
+
+	uint32_t children[4] = {0, 0, 0, 0};
+	uint32_t first = 0, count = 0; // range of quadtreeBodies under this quad, leaves hold up to quadtreeBucketSize bodies
+	double size, invsize, x, y, comx = 0.0, comy = 0.0, mass = 0.0;
+	double qxx = 0.0, qxy = 0.0, qyy = 0.0; // quadrupole moment about the centre of mass, only filled with gravityQuadrupoles or the fmm solver
+	bool used = false, leaf = false;
+};
+
+// quad storage in fixed size chunks that never move, so the tree can grow mid-build without copying or losing what's built
+struct QuadArena {
+	static constexpr uint32_t chunkBits = 10, chunkSize = 1u << chunkBits;
+
+	QuadArena();
+
+	inline Quad& operator[](uint32_t i) {
+		return chunks[i >> chunkBits][i & (chunkSize - 1)];
+	}
+	inline uint32_t capacity() const {
+		return chunks.size() * chunkSize;
+	}
+	void reserve(uint32_t count); // adds chunks until count quads fit
+	void release(uint32_t count); // frees the chunks past the ones count quads need
+
+	std::vector<std::unique_ptr<Quad[]>> chunks;
+};
+
+}
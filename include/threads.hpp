@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace obf {
+
+// long-lived workers, the thread calling parallelFor() participates as worker 0
+struct ThreadPool {
+	ThreadPool(int threads);
+	~ThreadPool();
+
+	// splits [0, count) into chunks of at least minChunk items and returns once all of them have been processed
+	void parallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& func);
+
+	int size();
+
+	// fraction of wall time spent in parallelFor() that each worker spent working, since the last resetStats()
+	std::vector<double> utilization();
+	void resetStats();
+
+	std::vector<std::thread> workers;
+	std::vector<double> busyTime; // per worker, seconds
+	double parallelTime = 0.0; // seconds spent inside parallelFor()
+	uint64_t jobs = 0;
+
+private:
+	void workerLoop(int index);
+	void runChunks(int index);
+
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	const std::function<void(size_t, size_t)>* job = nullptr;
+	size_t jobCount = 0, jobChunk = 0, jobChunks = 0;
+	std::atomic<size_t> nextChunk = 0;
+	int running = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+};
+
+// runs func over [0, count) on the update thread pool, (re)creating it to match updateThreadCount
+void parallelFor(size_t count, const std::function<void(size_t, size_t)>& func);
+// runs func(i) for every i in [0, tasks) on the update thread pool, for work that has already been split into big pieces
+void parallelTasks(size_t tasks, const std::function<void(size_t)>& func);
+// how many pieces parallelTasks() callers should split count items into
+size_t parallelParts(size_t count);
+
+void printThreadStats();
+
+}
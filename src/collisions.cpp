@@ -0,0 +1,109 @@
+#include "collisions.hpp"
+#include "entities.hpp"
+#include "globals.hpp"
+#include "math.hpp"
+#include "physics.hpp"
+#include "threads.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace obf {
+
+struct SweepEntry {
+	double x1, x2, y1, y2;
+	uint32_t slot;
+};
+
+static std::vector<SweepEntry> sweep;
+static std::vector<std::vector<std::pair<uint32_t, uint32_t>>> partPairs;
+static std::vector<std::pair<uint32_t, uint32_t>> pairs;
+static std::vector<std::vector<std::pair<Entity*, Entity*>>> partContacts;
+
+// whether b and body touch now or will before next tick
+static bool touching(uint32_t b, uint32_t body) {
+	double dVx = bodies.dVelX[body] - bodies.dVelX[b], dVy = bodies.dVelY[body] - bodies.dVelY[b],
+	dx = bodies.x[b] - bodies.x[body], dy = bodies.y[b] - bodies.y[body];
+	double radiusSum = bodies.radius[b] + bodies.radius[body];
+	if (dst2(dx, dy) <= radiusSum * radiusSum) {
+		return true;
+	} else if (std::abs(dx) - radiusSum < std::abs(dVx) && std::abs(dy) - radiusSum < std::abs(dVy)) { // possibly colliding before next frame?
+		double ivel = 1.0 / dst(dVx, dVy),
+		// calculate closest approach and at what x it will happen to check whether velocity is big enough to reach said closest approach
+		cApproach = (dx * dVy - dy * dVx) * ivel,
+		// cApproachAt = sqrt(dst2(dx, dy) - cApproach * cApproach); // distance the body will pass before closest approach
+		// collideAt = cApproachAt - sqrt(radiusSum * radiusSum - cApproach * cApproach); // distance the body will pass before colliding if abs(radiusSum) > abs(cApproach)
+		cApproachAtX = dx - cApproach * dVy * ivel;
+		return (std::abs(cApproach) < radiusSum && std::abs(cApproachAtX) <= std::abs(dVx) && std::signbit(cApproachAtX) == std::signbit(dVx)) || dst2(dx + dVx, dy + dVy) < radiusSum * radiusSum;
+	}
+	return false;
+}
+
+void collideBodies() {
+	size_t count = updateGroup.size();
+	// reach of every body until next tick, with the same margin the gravity walk used to check collisions with
+	sweep.resize(count);
+	parallelFor(count, [](size_t from, size_t to) {
+		for (size_t i = from; i < to; i++) {
+			double reachX = (bodies.radius[i] + std::abs(bodies.dVelX[i])) * 2.0, reachY = (bodies.radius[i] + std::abs(bodies.dVelY[i])) * 2.0;
+			sweep[i] = {bodies.x[i] - reachX, bodies.x[i] + reachX, bodies.y[i] - reachY, bodies.y[i] + reachY, (uint32_t)i};
+		}
+	});
+	std::sort(sweep.begin(), sweep.end(), [](const SweepEntry& a, const SweepEntry& b) {
+		// ties go by slot so the pair order, and with it the resolve order, doesn't depend on the sort
+		return a.x1 < b.x1 || (a.x1 == b.x1 && a.slot < b.slot);
+	});
+
+	// every overlapping pair is found once, by the body that starts further left
+	size_t parts = parallelParts(count), partSize = (count + parts - 1) / parts;
+	partPairs.resize(parts);
+	parallelTasks(parts, [&](size_t p) {
+		std::vector<std::pair<uint32_t, uint32_t>>& found = partPairs[p];
+		found.clear();
+		for (size_t i = p * partSize; i < std::min(count, (p + 1) * partSize); i++) {
+			const SweepEntry& a = sweep[i];
+			for (size_t j = i + 1; j < count && sweep[j].x1 <= a.x2; j++) {
+				const SweepEntry& b = sweep[j];
+				if (a.y1 <= b.y2 && b.y1 <= a.y2) {
+					found.push_back({a.slot, b.slot});
+				}
+			}
+		}
+	});
+	pairs.clear();
+	for (std::vector<std::pair<uint32_t, uint32_t>>& found : partPairs) {
+		pairs.insert(pairs.end(), found.begin(), found.end());
+	}
+
+	// collide() moves both bodies and can change their mass or remove them, so workers only record contacts
+	size_t contactParts = parallelParts(pairs.size()), contactPartSize = (pairs.size() + contactParts - 1) / contactParts;
+	partContacts.resize(contactParts);
+	parallelTasks(contactParts, [&](size_t p) {
+		std::vector<std::pair<Entity*, Entity*>>& contacts = partContacts[p];
+		contacts.clear();
+		for (size_t i = p * contactPartSize; i < std::min(pairs.size(), (p + 1) * contactPartSize); i++) {
+			auto [b, body] = pairs[i];
+			Entity* e = bodies.owner[b];
+			Entity* entity = bodies.owner[body];
+			if (touching(b, body)) {
+				contacts.push_back({e, entity});
+			}
+		}
+	});
+
+	// parts are contiguous ranges of pairs, so this is pair order whatever the thread count
+	for (std::vector<std::pair<Entity*, Entity*>>& contacts : partContacts) {
+		for (auto [e, entity] : contacts) {
+			// already absorbed or destroyed by an earlier contact this tick
+			if (!e->active || !entity->active) {
+				continue;
+			}
+			e->collide(entity, false);
+			entity->collide(e, true);
+		}
+	}
+}
+
+}
@@ -1,16 +1,20 @@
 #include "camera.hpp"
+#include "collisions.hpp"
 #include "entities.hpp"
 #include "globals.hpp"
+#include "gravity.hpp"
 #include "math.hpp"
 #include "net.hpp"
+#include "threads.hpp"
 #include "types.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <exception>
 #include <iostream>
 #include <sstream>
-#include <thread>
+#include <utility>
 #include <vector>
 
 #include <SFML/Graphics.hpp>
@@ -27,11 +31,11 @@ void setupShip(Entity* ship, bool sync) {
 		return;
 	}
 	CelestialBody* planet = planets[(int)rand_f(0, planets.size())];
-	double spawnDst = planet->radius * rand_f(shipSpawnDistanceMin, shipSpawnDistanceMax);
+	double spawnDst = planet->radius() * rand_f(shipSpawnDistanceMin, shipSpawnDistanceMax);
 	float spawnAngle = rand_f(-PI, PI);
-	ship->setPosition(planet->x + spawnDst * std::cos(spawnAngle), planet->y + spawnDst * std::sin(spawnAngle));
-	double vel = sqrt(G * planet->mass / spawnDst);
-	ship->setVelocity(planet->velX + vel * std::cos(spawnAngle + PI / 2.0), planet->velY + vel * std::sin(spawnAngle + PI / 2.0));
+	ship->setPosition(planet->x() + spawnDst * std::cos(spawnAngle), planet->y() + spawnDst * std::sin(spawnAngle));
+	double vel = sqrt(G * planet->mass() / spawnDst);
+	ship->setVelocity(planet->velX() + vel * std::cos(spawnAngle + PI / 2.0), planet->velY() + vel * std::sin(spawnAngle + PI / 2.0));
 	if (sync) {
 		sf::Packet packet;
 		packet << Packets::SyncEntity;
@@ -57,7 +61,7 @@ int generateOrbitingPlanets(int amount, double x, double y, double velx, double
 		planet->setColor((int)rand_f(64.f, 255.f), (int)rand_f(64.f, 255.f), (int)rand_f(64.f, 255.f));
 		int moons = (int)(rand_f(0.f, 1.f) * radius * radius / (gen_moonFactor * gen_moonFactor));
 		obf::planets.push_back(planet);
-		totalMoons += moons + generateOrbitingPlanets(moons, planet->x, planet->y, planet->velX, planet->velY, planet->mass, gen_minMoonRadius, planet->radius * gen_maxMoonRadiusFrac, planet->radius * (1.0 + rand_f(gen_minMoonDistance, gen_minMoonDistance + pow(gen_maxMoonDistance, std::min(1.0, 0.5 / (planet->radius / gen_maxPlanetRadius))))));
+		totalMoons += moons + generateOrbitingPlanets(moons, planet->x(), planet->y(), planet->velX(), planet->velY(), planet->mass(), gen_minMoonRadius, planet->radius() * gen_maxMoonRadiusFrac, planet->radius() * (1.0 + rand_f(gen_minMoonDistance, gen_minMoonDistance + pow(gen_maxMoonDistance, std::min(1.0, 0.5 / (planet->radius() / gen_maxPlanetRadius))))));
 	}
 	return totalMoons;
 }
@@ -88,8 +92,8 @@ void generateSystem() {
 	if (starsN > 1) {
 		double aX = 0.0, aY = 0.0;
 		for (int i = 1; i < starsN; i++) {
-			double xdiff = stars[i]->x - stars[0]->x, ydiff = stars[i]->y - stars[0]->y,
-			factor = stars[i]->mass * G / pow(xdiff * xdiff + ydiff * ydiff, 1.5);
+			double xdiff = stars[i]->x() - stars[0]->x(), ydiff = stars[i]->y() - stars[0]->y(),
+			factor = stars[i]->mass() * G / pow(xdiff * xdiff + ydiff * ydiff, 1.5);
 			aX += factor * xdiff;
 			aY += factor * ydiff;
 		}
@@ -133,45 +137,85 @@ void fullClear(bool clearTriangles) {
 	lastTrajectoryRef = nullptr;
 }
 
-void updateEntities2(size_t from, size_t to) {
-	for (size_t i = from; i < to; i++) {
-		updateGroup[i]->update2();
-	}
-} // in a function for multithreading purposes
+// yoshida's 4th order step is three leapfrog steps of these fractions of a tick
+static const double yoshidaW1 = 1.0 / (2.0 - std::cbrt(2.0)), yoshidaW0 = 1.0 - 2.0 * yoshidaW1;
+
+static void markDue(uint64_t tick) {
+	parallelFor(updateGroup.size(), [tick](size_t from, size_t to) {
+		markDueBodies(from, to, tick);
+	});
+}
+
+static void kickDue(double step) {
+	parallelFor(updateGroup.size(), [step](size_t from, size_t to) {
+		kickBodies(from, to, step);
+	});
+}
+
+// leapfrog step that only moves bodies under gravity, all bodies are on level 0 with yoshida
+static void gravityStep(double step) {
+	kickDue(step * 0.5);
+	parallelFor(updateGroup.size(), [step](size_t from, size_t to) {
+		moveBodies(from, to, step);
+	});
+	findGravity();
+	kickDue(step * 0.5);
+}
 
 void updateEntities() {
-	if (updateThreadCount == 1 || updateGroup.size() <= minThreadEntities) {
-		updateEntities2(0, updateGroup.size());
-		return;
-	}
-	size_t prev = 0;
-	for (int i = 0; i < updateThreadCount; i++) {
-		size_t to = i == updateThreadCount - 1 ? updateGroup.size() : (size_t)((float)(updateGroup.size() * (i + 1)) / (float)updateThreadCount);
-		if (to - prev < minThreadEntities && i != updateThreadCount - 1) {
-			continue;
-		}
-		updateThreads.push_back(new std::thread(updateEntities2, prev, to));
-		prev = to;
-	}
-	for (int i = updateThreads.size() - 1; i >= 0; i--) {
-		updateThreads[i]->join();
-		delete updateThreads[i];
-	}
-	updateThreads.clear();
+	syncBodies();
+	bool euler = integrator == "euler", yoshida = integrator == "yoshida";
+	// block timesteps, a body at level k drifts every tick but only has its gravity found and applied every 2^k ticks, at the ends of its blocks
+	int maxLevel = yoshida ? 0 : std::clamp(blockLevels, 0, 16);
+	auto levelsEnd = bodies.level.begin() + updateGroup.size();
+	if (std::find(bodies.level.begin(), levelsEnd, unsetLevel) != levelsEnd) {
+		// new bodies have no gravity stored for their first kick yet, euler doesn't kick before moving so doesn't need it
+		for (size_t i = 0; i < updateGroup.size(); i++) {
+			bodies.due[i] = bodies.level[i] == unsetLevel;
+		}
+		if (!euler) {
+			findGravity();
+		}
+		for (size_t i = 0; i < updateGroup.size(); i++) {
+			bodies.level[i] = bodies.due[i] ? 0 : bodies.level[i];
+		}
+	}
+	markDue(blockTick);
+	double step = delta;
+	if (yoshida) {
+		// the first two steps only move bodies under gravity, entity updates and collisions happen once in the last
+		gravityStep(yoshidaW1 * delta);
+		gravityStep(yoshidaW0 * delta);
+		step = yoshidaW1 * delta;
+	}
+	// kick drift kick, the first kick of a block uses the gravity found at the end of the last one
+	if (!euler) {
+		kickDue(step * 0.5);
+	}
+	parallelFor(updateGroup.size(), [step](size_t from, size_t to) {
+		moveBodies(from, to, step);
+		for (size_t i = from; i < to; i++) {
+			updateGroup[i]->update1();
+		}
+	});
+	parallelFor(updateGroup.size(), [](size_t from, size_t to) {
+		for (size_t i = from; i < to; i++) {
+			updateGroup[i]->update2();
+		}
+	});
+	collideBodies();
+	blockTick++;
+	markDue(blockTick);
+	// after collisions so a tree holds the bodies where they are walked from
+	findGravity();
+	kickDue(euler ? step : step * 0.5);
+	parallelFor(updateGroup.size(), [maxLevel](size_t from, size_t to) {
+		levelBodies(from, to, delta, blockTick, maxLevel);
+	});
 }
 
 Entity* idLookup(uint32_t id) {
-	size_t searchBy = 0;
-	for (size_t i = 1; i > 0; i = i << 1) {
-		searchBy = std::max(searchBy, updateGroup.size() & i);
-	}
-	size_t at = 0;
-	for (size_t i = searchBy; i > 0; i = i >> 1) {
-		if (at + i < updateGroup.size() && updateGroup[at + i]->id <= id) {
-			at += i;
-		}
-	}
-	return updateGroup[at]->id == id ? updateGroup[at] : nullptr;
+	return entityTable.byId(id);
 }
 
 std::string Player::name() {
@@ -200,13 +244,26 @@ Entity::Entity() {
 	id = nextID;
 	nextID++;
 	updateGroup.push_back(this);
-	ghost = simulating;
+	slot = bodies.add(this);
+	handle = entityTable.add(this);
+	if (!spareTrajectories.empty()) {
+		trajectory = std::move(spareTrajectories.back());
+		spareTrajectories.pop_back();
+		trajectoriesReused++;
+	}
 }
 
 Entity::~Entity() noexcept {
 	if (debug) {
 		printf("Deleting entity id %u\n", this->id);
 	}
+	bodies.remove(slot);
+	entityTable.remove(handle);
+	// no more spares are kept than there are entities left to reuse them, the rest are freed
+	if (trajectory.capacity() > 0 && spareTrajectories.size() < bodies.size()) {
+		trajectory.clear();
+		spareTrajectories.push_back(std::move(trajectory));
+	}
 }
 
 void Entity::syncCreation() {
@@ -222,15 +279,11 @@ void Entity::control(movement&) {
 	return;
 }
 void Entity::update1() {
-	dVelX = velX * delta;
-	dVelY = velY * delta;
-	x += dVelX;
-	y += dVelY;
+	// position is advanced for all bodies at once by moveBodies()
 	rotation += rotateVel * delta;
-	collided.clear();
 }
 void Entity::update2() {
-	quadtree[0].collideAttract(this, true, true);
+	// collisions are handled by collideBodies() and gravity by findGravity()
 }
 
 void Entity::draw() {
@@ -242,7 +295,7 @@ void Entity::draw() {
 		float decBy = (255.f - 64.f) / (to);
 		for (size_t i = 0; i < to; i++){
 			Point point = trajectory[i + trajectoryOffset];
-			lines[i].position = sf::Vector2f(lastTrajectoryRef->x + point.x + drawShiftX, lastTrajectoryRef->y + point.y + drawShiftY);
+			lines[i].position = sf::Vector2f(lastTrajectoryRef->x() + point.x + drawShiftX, lastTrajectoryRef->y() + point.y + drawShiftY);
 			lines[i].color = trajColor;
 			lines[i].color.a = (uint8_t)lastAlpha;
 			lastAlpha -= decBy;
@@ -255,21 +308,21 @@ void Entity::collide(Entity* with, bool specialOnly) {
 	if (specialOnly) {
 		return;
 	}
-	if (debug && !simulating && dst2(with->velX - velX, with->velY - velY) > 0.1) [[unlikely]] {
+	if (debug && dst2(with->velX() - velX(), with->velY() - velY()) > 0.1) [[unlikely]] {
 		printf("collision: %u-%u\n", id, with->id);
 	}
-	double massFactorThis = 1.0 / (1.0 + mass / with->mass);
-	double massFactorOther = 1.0 / (1.0 + with->mass / mass); // for conservation of momentum
-	double inHeading = std::atan2(y - with->y, x - with->x); // heading of vector from other to this
+	double massFactorThis = 1.0 / (1.0 + mass() / with->mass());
+	double massFactorOther = 1.0 / (1.0 + with->mass() / mass()); // for conservation of momentum
+	double inHeading = std::atan2(y() - with->y(), x() - with->x()); // heading of vector from other to this
 	double inX = std::cos(inHeading);
 	double inY = std::sin(inHeading);
-	double newX = x + (with->x - x + (radius + with->radius) * inX) * massFactorThis;
-	double newY = y + (with->y - y + (radius + with->radius) * inY) * massFactorThis;
-	with->x -= (with->x - x + (radius + with->radius) * inX) * massFactorOther;
-	with->y -= (with->y - y + (radius + with->radius) * inY) * massFactorOther;
-	x = newX;
-	y = newY;
-	double dVx = with->velX - velX, dVy = with->velY - velY;
+	double newX = x() + (with->x() - x() + (radius() + with->radius()) * inX) * massFactorThis;
+	double newY = y() + (with->y() - y() + (radius() + with->radius()) * inY) * massFactorThis;
+	with->x() -= (with->x() - x() + (radius() + with->radius()) * inX) * massFactorOther;
+	with->y() -= (with->y() - y() + (radius() + with->radius()) * inY) * massFactorOther;
+	x() = newX;
+	y() = newY;
+	double dVx = with->velX() - velX(), dVy = with->velY() - velY();
 	double velHeading = std::atan2(dVy, dVx); // heading of own relative velocity
 	double factor = std::cos(std::abs(deltaAngleRad(inHeading, velHeading)));
 	if (factor < 0.0) {
@@ -280,229 +333,12 @@ void Entity::collide(Entity* with, bool specialOnly) {
 	with->addVelocity(-massFactorOther * (inX * factor + friction * delta * dVx), -massFactorOther * (inY * factor + friction * delta * dVy));
 }
 
-void Entity::simSetup() {
-	resX = x;
-	resY = y;
-	resVelX = velX;
-	resVelY = velY;
-	resRotation = rotation;
-	resRotateVel = rotateVel;
-	resMass = mass;
-	resRadius = radius;
-}
-void Entity::simReset() {
-	x = resX;
-	y = resY;
-	velX = resVelX;
-	velY = resVelY;
-	rotation = resRotation;
-	rotateVel = resRotateVel;
-	mass = resMass;
-	radius = resRadius;
-}
-
-void Entity::onEntityDelete(Entity* d) {
-	if (simRelBody == d) {
-		simRelBody = nullptr;
-	}
-}
-
-Quad& Quad::getChild(uint8_t at) {
-	if (children[at] == 0) {
-		if (quadsConstructed == quadsAllocated) [[unlikely]] {
-			throw std::bad_alloc();
-		}
-		Quad& child = quadtree[quadsConstructed];
-		child = Quad();
-		double halfsize = size * 0.5;
-		child.x = at == 1 || at == 3 ? x + halfsize : x;
-		child.y = at > 1 ? y + halfsize : y;
-		child.size = halfsize;
-		child.invsize = invsize * 2;
-		children[at] = quadsConstructed;
-		quadsConstructed++;
-		return child;
-	}
-	return quadtree[children[at]];
-}
-void Quad::put(Entity* e) {
-	mass += e->mass;
-	comx += e->mass * e->x;
-	comy += e->mass * e->y;
-	if (used) {
-		getChild((e->x > x + size * 0.5) + 2 * (e->y > y + size * 0.5)).put(e);
-		if (entity) {
-			if (entity->ghost && entity->parent_id == e->id) [[unlikely]] {
-				entity = nullptr;
-				return;
-			}
-			getChild((entity->x > x + size * 0.5) + 2 * (entity->y > y + size * 0.5)).put(entity);
-			entity = nullptr;
-		}
-	} else {
-		entity = e;
-		used = true;
-	}
-}
-uint32_t Quad::unstaircasize() {
-	for (uint32_t& c : children) {
-		if (c != 0) {
-			Quad& quad = quadtree[c];
-			uint32_t retcode = quad.unstaircasize();
-			if (quad.comx == comx && quad.comy == comy) {
-				return retcode == 0 ? c : retcode;
-			} else if (retcode != 0) {
-				c = retcode;
-			}
-		}
-	}
-	return 0;
-}
-void Quad::postBuild() {
-	comx /= mass;
-	comy /= mass;
-	for (uint32_t c : children) {
-		if (c != 0) {
-			quadtree[c].postBuild();
-		}
-	}
-}
-void Quad::collideAttract(Entity* e, bool doGravity, bool checkCollide) {
-	checkCollide = checkCollide && e->x + (e->radius + std::abs(e->dVelX)) * 2.0 > x && e->y + (e->radius + std::abs(e->dVelY)) * 2.0 > y && e->x - (e->radius + std::abs(e->dVelX)) * 2.0 < x + size && e->y - (e->radius + std::abs(e->dVelY)) * 2.0 < y + size;
-	if (entity && entity != e) {
-		if (e->parent_id == entity->id || entity->parent_id == e->id) [[unlikely]] {
-			return;
-		}
-		if (checkCollide && std::find(e->collided.begin(), e->collided.end(), entity->id) == e->collided.end()) {
-			double dVx = entity->dVelX - e->dVelX, dVy = entity->dVelY - e->dVelY,
-			dx = e->x - entity->x, dy = e->y - entity->y;
-			double radiusSum = e->radius + entity->radius;
-			if (dst2(dx, dy) <= radiusSum * radiusSum) {
-				e->collide(entity, false);
-				entity->collide(e, true);
-				entity->collided.push_back(e->id);
-			} else if (std::abs(dx) - radiusSum < std::abs(dVx) && std::abs(dy) - radiusSum < std::abs(dVy)) { // possibly colliding before next frame?
-				double ivel = 1.0 / dst(dVx, dVy),
-				// calculate closest approach and at what x it will happen to check whether velocity is big enough to reach said closest approach
-				cApproach = (dx * dVy - dy * dVx) * ivel,
-				// cApproachAt = sqrt(dst2(dx, dy) - cApproach * cApproach); // distance the body will pass before closest approach
-				// collideAt = cApproachAt - sqrt(radiusSum * radiusSum - cApproach * cApproach); // distance the body will pass before colliding if abs(radiusSum) > abs(cApproach)
-				cApproachAtX = dx - cApproach * dVy * ivel;
-				if ((std::abs(cApproach) < radiusSum && std::abs(cApproachAtX) <= std::abs(dVx) && std::signbit(cApproachAtX) == std::signbit(dVx)) || dst2(dx + dVx, dy + dVy) < radiusSum * radiusSum) {
-					e->collide(entity, false);
-					entity->collide(e, true);
-					entity->collided.push_back(e->id);
-				}
-			}
-		}
-		if (doGravity) {
-			double xdiff = entity->x - e->x, ydiff = entity->y - e->y;
-			double dist = dst(xdiff, ydiff);
-			double factor = entity->mass * delta * G / (dist * dist * dist);
-			e->addVelocity(xdiff * factor, ydiff * factor);
-		}
-		return;
-	}
-	if (doGravity) {
-		double halfsize = size * 0.5, midx = x + halfsize, midy = y + halfsize;
-		if (invsize * (std::abs(e->x - midx) + std::abs(e->y - midy)) > gravityAccuracy) {
-			double xdiff = comx - e->x, ydiff = comy - e->y;
-			double dist = dst(xdiff, ydiff);
-			double factor = delta * mass * G / (dist * dist * dist);
-			e->addVelocity(xdiff * factor, ydiff * factor);
-			doGravity = false;
-		}
-	} else if (!checkCollide) {
-		return;
-	}
-	for (uint32_t c : children) {
-		if (c != 0) {
-			quadtree[c].collideAttract(e, doGravity, checkCollide);
-		}
-	}
-}
-void Quad::draw() {
-	sf::RectangleShape quad(sf::Vector2f(size / g_camera.scale, size / g_camera.scale));
-	quad.setPosition(g_camera.w * 0.5 + (x - ownX) / g_camera.scale, g_camera.h * 0.5 + (y - ownY) / g_camera.scale);
-	quad.setFillColor(sf::Color(0, 0, 0, 0));
-	quad.setOutlineColor(sf::Color(0, 0, 255, 255));
-	quad.setOutlineThickness(1);
-	window->draw(quad);
-	for (uint32_t c : children) {
-		if (c != 0) {
-			quadtree[c].draw();
-		}
-	}
-}
-
-void reallocateQuadtree() {
-	quadsAllocated = std::max(minQuadtreeSize, (int)(quadsConstructed * extraQuadAllocation));
-	Quad* newQuadtree = (Quad*)malloc(quadsAllocated * sizeof(Quad));
-	memcpy(newQuadtree, quadtree, quadsConstructed * sizeof(Quad));
-	delete quadtree;
-	quadtree = newQuadtree;
-	if (debug) [[unlikely]] {
-		printf("Reallocated quadtree, new size: %u\n", quadsAllocated);
-	}
-}
-void buildQuadtree() {
-	double x1 = +INFINITY, y1 = +INFINITY, x2 = -INFINITY, y2 = -INFINITY;
-	for (Entity* e : updateGroup) {
-		x1 = std::min(e->x, x1);
-		y1 = std::min(e->y, y1);
-		x2 = std::max(e->x, x2);
-		y2 = std::max(e->y, y2);
-	}
-	quadtree[0] = Quad();
-	quadtree[0].x = x1;
-	quadtree[0].y = y1;
-	quadtree[0].size = std::max(x2 - x1, y2 - y1);
-	quadtree[0].invsize = 1.0 / quadtree[0].size;
-	quadsConstructed = 1;
-	for (size_t i = 0; i < updateGroup.size(); i++) {
-		try {
-			quadtree[0].put(updateGroup[i]);
-		} catch (const std::bad_alloc& except) {
-			free(quadtree);
-			quadsAllocated = (int)(quadsAllocated * extraQuadAllocation);
-			quadtree = (Quad*)malloc(quadsAllocated * sizeof(Quad));
-			quadtree[0] = Quad();
-			quadsConstructed = 1;
-			i = 0;
-			if (debug) [[unlikely]] {
-				printf("Ran out of memory for quadtree, new size: %u\nPerforming investigation...", quadsAllocated);
-				for (Entity* e1 : updateGroup) {
-					for (Entity* e2 : updateGroup) {
-						if (e1->x == e2->x || e1->y == e2->y) [[unlikely]] {
-							printf("Found entities with equal coordinates: %g, %g and %g, %g\n", e1->x, e1->y, e2->x, e2->y);
-						}
-					}
-				}
-			}
-		}
-		if (quadsConstructed > quadsAllocated * quadReallocateThreshold) [[unlikely]] {
-			if (debug) [[unlikely]] {
-				printf("Expanding quadtree... ");
-			}
-			reallocateQuadtree();
-		}
-	}
-	quadtree[0].unstaircasize();
-	quadtree[0].postBuild();
-	if (std::max((double)quadsConstructed, minQuadtreeSize / quadtreeShrinkThreshold) < quadsAllocated * quadtreeShrinkThreshold) [[unlikely]] {
-		if (debug) [[unlikely]] {
-			printf("Shrinking quadtree... ");
-		}
-		reallocateQuadtree();
-	}
-}
-
 Triangle::Triangle() : Entity() {
-	mass = 1000000.0;
-	radius = 16.0;
-	if (!headless && !simulating) {
-		shape = std::make_unique<sf::CircleShape>(radius, 3);
-		shape->setOrigin(radius, radius);
+	mass() = 1000000.0;
+	radius() = 16.0;
+	if (!headless) {
+		shape = std::make_unique<sf::CircleShape>(radius(), 3);
+		shape->setOrigin(radius(), radius());
 		forwards = std::make_unique<sf::CircleShape>(2.f, 6);
 		forwards->setOrigin(2.f, 2.f);
 		icon = std::make_unique<sf::CircleShape>(3.f, 3);
@@ -512,39 +348,24 @@ Triangle::Triangle() : Entity() {
 }
 
 void Triangle::loadCreatePacket(sf::Packet& packet) {
-	packet << type() << id << x << y << velX << velY << rotation << name;
+	packet << type() << id << x() << y() << velX() << velY() << rotation << name;
 	if (debug) {
-		printf("Sent id %d: %g %g %g %g\n", id, x, y, velX, velY);
+		printf("Sent id %d: %g %g %g %g\n", id, x(), y(), velX(), velY());
 	}
 }
 void Triangle::unloadCreatePacket(sf::Packet& packet) {
-	packet >> id >> x >> y >> velX >> velY >> rotation >> name;
+	packet >> id >> x() >> y() >> velX() >> velY() >> rotation >> name;
 	if (debug) {
-		printf("Received id %d: %g %g %g %g\n", id, x, y, velX, velY);
+		printf("Received id %d: %g %g %g %g\n", id, x(), y(), velX(), velY());
 	}
 }
 void Triangle::loadSyncPacket(sf::Packet& packet) {
-	packet << id << x << y << velX << velY << rotation;
+	packet << id << x() << y() << velX() << velY() << rotation;
 }
 void Triangle::unloadSyncPacket(sf::Packet& packet) {
 	packet >> syncX >> syncY >> syncVelX >> syncVelY >> rotation;
 }
 
-void Triangle::simSetup() {
-	Entity::simSetup();
-	resBoostProgress = boostProgress;
-	resReloadProgress = reloadProgress;
-	resHyperboostCharge = hyperboostCharge;
-	resBurning = burning;
-}
-void Triangle::simReset() {
-	Entity::simReset();
- 	boostProgress = resBoostProgress;
-	reloadProgress = resReloadProgress;
-	hyperboostCharge = resHyperboostCharge;
-	burning = resBurning;
-}
-
 void Triangle::control(movement& cont) {
 	float rotationRad = rotation * degToRad;
 	double xMul = std::cos(rotationRad), yMul = -std::sin(rotationRad);
@@ -624,16 +445,13 @@ void Triangle::control(movement& cont) {
 	if (cont.primaryfire && reloadProgress > reload) {
 		if (authority) {
 			Projectile* proj = new Projectile();
-			if (simulating) {
-				simCleanupBuffer.push_back(proj);
-			}
-			proj->setPosition(x + (radius + proj->radius * 3.0) * xMul, y + (radius + proj->radius * 3.0) * yMul);
-			addVelocity(-shootPower * xMul * proj->mass / mass, -shootPower * yMul * proj->mass / mass);
-			proj->setVelocity(velX + shootPower * xMul, velY + shootPower * yMul);
+			proj->setPosition(x() + (radius() + proj->radius() * 3.0) * xMul, y() + (radius() + proj->radius() * 3.0) * yMul);
+			addVelocity(-shootPower * xMul * proj->mass() / mass(), -shootPower * yMul * proj->mass() / mass());
+			proj->setVelocity(velX() + shootPower * xMul, velY() + shootPower * yMul);
 			proj->rotation = rotation;
 			proj->rotateVel = rotateVel;
 			proj->owner = this;
-			proj->target = target;
+			proj->setTarget(target);
 			if (isServer) {
 				proj->syncCreation();
 			}
@@ -644,13 +462,13 @@ void Triangle::control(movement& cont) {
 
 void Triangle::draw() {
 	Entity::draw();
-	shape->setPosition(x + drawShiftX, y + drawShiftY);
+	shape->setPosition(x() + drawShiftX, y() + drawShiftY);
 	shape->setRotation(90.f - rotation);
 	shape->setFillColor(sf::Color(color[0], color[1], color[2]));
 	window->draw(*shape);
 	g_camera.bindUI();
 	float rotationRad = rotation * degToRad;
-	double uiX = g_camera.w * 0.5 + (x - ownX) / g_camera.scale, uiY = g_camera.h * 0.5 + (y - ownY) / g_camera.scale;
+	double uiX = g_camera.w * 0.5 + (x() - ownX) / g_camera.scale, uiY = g_camera.h * 0.5 + (y() - ownY) / g_camera.scale;
 	forwards->setPosition(uiX + 14.0 * cos(rotationRad), uiY - 14.0 * sin(rotationRad));
 	if (ownEntity == this) {
 		float reloadProgress = (-this->reloadProgress / reload + 1.0) * 40.f,
@@ -693,27 +511,20 @@ void Triangle::draw() {
 		nameText.setPosition(uiX - nameText.getLocalBounds().width / 2.0, uiY - 28.0);
 		window->draw(nameText);
 	}
-	if (g_camera.scale * 2.0 > radius) {
+	if (g_camera.scale * 2.0 > radius()) {
 		icon->setPosition(uiX, uiY);
 		window->draw(*icon);
 	}
 	g_camera.bindWorld();
 }
 
-void Triangle::onEntityDelete(Entity* d) {
-	Entity::onEntityDelete(d);
-	if (target == d) {
-		target = nullptr;
-	}
-}
-
 uint8_t Triangle::type() {
 	return Entities::Triangle;
 }
 
 CelestialBody::CelestialBody(double radius) : Entity() {
-	this->radius = radius;
-	this->mass = 1.0e18;
+	this->radius() = radius;
+	this->mass() = 1.0e18;
 	if (!headless) {
 		shape = std::make_unique<sf::CircleShape>(radius, std::max(4, (int)(sqrt(radius))));
 		shape->setOrigin(radius, radius);
@@ -727,8 +538,8 @@ CelestialBody::CelestialBody(double radius) : Entity() {
 	}
 }
 CelestialBody::CelestialBody(double radius, double mass) : Entity() {
-	this->radius = radius;
-	this->mass = mass;
+	this->radius() = radius;
+	this->mass() = mass;
 	if (!headless) {
 		shape = std::make_unique<sf::CircleShape>(radius, std::max(4, (int)(sqrt(radius))));
 		shape->setOrigin(radius, radius);
@@ -753,19 +564,19 @@ CelestialBody::CelestialBody(bool) {
 }
 
 void CelestialBody::loadCreatePacket(sf::Packet& packet) {
-	packet << type() << radius << id << x << y << velX << velY << mass << star << blackhole << color[0] << color[1] << color[2];
+	packet << type() << radius() << id << x() << y() << velX() << velY() << mass() << star << blackhole << color[0] << color[1] << color[2];
 	if (debug) {
-		printf("Sent id %d: %g %g %g %g\n", id, x, y, velX, velY);
+		printf("Sent id %d: %g %g %g %g\n", id, x(), y(), velX(), velY());
 	}
 }
 void CelestialBody::unloadCreatePacket(sf::Packet& packet) {
-	packet >> id >> x >> y >> velX >> velY >> mass >> star >> blackhole >> color[0] >> color[1] >> color[2];
+	packet >> id >> x() >> y() >> velX() >> velY() >> mass() >> star >> blackhole >> color[0] >> color[1] >> color[2];
 	if (debug) {
-		printf(", id %d: %g %g %g %g\n", id, x, y, velX, velY);
+		printf(", id %d: %g %g %g %g\n", id, x(), y(), velX(), velY());
 	}
 }
 void CelestialBody::loadSyncPacket(sf::Packet& packet) {
-	packet << id << x << y << velX << velY;
+	packet << id << x() << y() << velX() << velY();
 }
 void CelestialBody::unloadSyncPacket(sf::Packet& packet) {
 	packet >> syncX >> syncY >> syncVelX >> syncVelY;
@@ -788,23 +599,23 @@ void CelestialBody::collide(Entity* with, bool specialOnly) {
 			with->active = false;
 		}
 	} else if (authority && with->type() == Entities::CelestialBody) [[unlikely]] {
-		if (mass >= with->mass) {
-			if (!simulating && printPlanetMerges) {
+		if (mass() >= with->mass()) {
+			if (printPlanetMerges) {
 				printf("Planetary collision: %u absorbed %u\n", id, with->id);
 			}
-			double radiusMul = sqrt((mass + with->mass) / mass);
-			mass += with->mass;
-			radius *= radiusMul;
+			double radiusMul = sqrt((mass() + with->mass()) / mass());
+			mass() += with->mass();
+			radius() *= radiusMul;
 			if (isServer) {
 				sf::Packet collisionPacket;
-				collisionPacket << Packets::PlanetCollision << id << mass << radius;
+				collisionPacket << Packets::PlanetCollision << id << mass() << radius();
 				for (Player* p : playerGroup) {
 					p->tcpSocket.send(collisionPacket);
 				}
 			}
-			if (!headless && !simulating) {
-				shape->setRadius(radius);
-	            shape->setOrigin(radius, radius);
+			if (!headless) {
+				shape->setRadius(radius());
+	            shape->setOrigin(radius(), radius());
 			}
 			with->active = false;
 		}
@@ -813,13 +624,13 @@ void CelestialBody::collide(Entity* with, bool specialOnly) {
 
 void CelestialBody::draw() {
 	Entity::draw();
-	shape->setPosition(x + drawShiftX, y + drawShiftY);
+	shape->setPosition(x() + drawShiftX, y() + drawShiftY);
 	shape->setFillColor(sf::Color(color[0], color[1], color[2]));
 	window->draw(*shape);
 	if (ownEntity) {
 		g_camera.bindUI();
-		double uiX = g_camera.w * 0.5 + (x - ownX) / g_camera.scale, uiY = g_camera.h * 0.5 + (y - ownY) / g_camera.scale;
-		if (g_camera.scale > radius) {
+		double uiX = g_camera.w * 0.5 + (x() - ownX) / g_camera.scale, uiY = g_camera.h * 0.5 + (y() - ownY) / g_camera.scale;
+		if (g_camera.scale > radius()) {
 			icon->setPosition(uiX, uiY);
 			icon->setFillColor(sf::Color(color[0], color[1], color[2]));
 			window->draw(*icon);
@@ -837,14 +648,14 @@ uint8_t CelestialBody::type() {
 }
 
 Projectile::Projectile() : Entity() {
-	radius = 4.0;
-	this->mass = 20000.0;
+	radius() = 4.0;
+	this->mass() = 20000.0;
 	this->color[0] = 180;
 	this->color[1] = 0;
 	this->color[2] = 0;
-	if (!headless && !simulating) {
-		shape = std::make_unique<sf::CircleShape>(radius, 3);
-		shape->setOrigin(radius, radius);
+	if (!headless) {
+		shape = std::make_unique<sf::CircleShape>(radius(), 3);
+		shape->setOrigin(radius(), radius());
 		icon = std::make_unique<sf::CircleShape>(2.f, 3);
 		icon->setOrigin(2.f, 2.f);
 		icon->setFillColor(sf::Color(255, 0, 0));
@@ -857,10 +668,20 @@ Projectile::Projectile() : Entity() {
 	}
 }
 
+Projectile::~Projectile() noexcept {
+	// a projectile chasing this one goes after its owner instead
+	for (EntityRef ref : chasers) {
+		Projectile* chaser = (Projectile*)ref.get();
+		if (chaser && chaser->target == this) {
+			chaser->setTarget(owner != chaser->owner ? owner.get() : nullptr);
+		}
+	}
+}
+
 void Projectile::update2() {
 	if (target) {
-		double dVx = target->velX - velX, dVy = target->velY - velY;
-		double dX = target->x - x, dY = target->y - y;
+		double dVx = target->velX() - velX(), dVy = target->velY() - velY();
+		double dX = target->x() - x(), dY = target->y() - y();
 		double inHeading = std::atan2(dY, dX), tangentHeading = inHeading + 0.5 * PI;
 		double velHeading = std::atan2(dVy, dVx);
 		double tangentVel = dst(dVx, dVy) * std::cos(deltaAngleRad(tangentHeading, velHeading));
@@ -877,23 +698,23 @@ void Projectile::update2() {
 }
 
 void Projectile::loadCreatePacket(sf::Packet& packet) {
-	packet << type() << id << x << y << velX << velY << rotation << (target == nullptr ? std::numeric_limits<uint32_t>::max() : target->id) << (owner == nullptr ? std::numeric_limits<uint32_t>::max() : owner->id);
+	packet << type() << id << x() << y() << velX() << velY() << rotation << (target == nullptr ? std::numeric_limits<uint32_t>::max() : target->id) << (owner == nullptr ? std::numeric_limits<uint32_t>::max() : owner->id);
 	if (debug) {
-		printf("Sent id %d: %g %g %g %g\n", id, x, y, velX, velY);
+		printf("Sent id %d: %g %g %g %g\n", id, x(), y(), velX(), velY());
 	}
 }
 void Projectile::unloadCreatePacket(sf::Packet& packet) {
-	packet >> id >> x >> y >> velX >> velY >> rotation;
+	packet >> id >> x() >> y() >> velX() >> velY() >> rotation;
 	uint32_t entityID, ownerID;
 	packet >> entityID >> ownerID;
-	target = entityID == std::numeric_limits<uint32_t>::max() ? nullptr : idLookup(entityID);
+	setTarget(entityID == std::numeric_limits<uint32_t>::max() ? nullptr : idLookup(entityID));
 	owner = ownerID == std::numeric_limits<uint32_t>::max() ? nullptr : idLookup(ownerID);
 	if (debug) {
-		printf(", id %d: %g %g %g %g\n", id, x, y, velX, velY);
+		printf(", id %d: %g %g %g %g\n", id, x(), y(), velX(), velY());
 	}
 }
 void Projectile::loadSyncPacket(sf::Packet& packet) {
-	packet << id << x << y << velX << velY << rotation;
+	packet << id << x() << y() << velX() << velY() << rotation;
 }
 void Projectile::unloadSyncPacket(sf::Packet& packet) {
 	packet >> syncX >> syncY >> syncVelX >> syncVelY >> rotation;
@@ -911,7 +732,7 @@ void Projectile::collide(Entity* with, bool specialOnly) {
 			printf("of type triangle\n");
 		}
 		if (authority) {
-			if (!simulating && (with->player || !isServer || with == ownEntity)) {
+			if (with->player || !isServer || with == ownEntity) {
 				if (isServer) {
 					std::string sendMessage;
 					sendMessage.append("<").append(((Triangle*)with)->name).append("> has been killed.");
@@ -948,30 +769,27 @@ void Projectile::collide(Entity* with, bool specialOnly) {
 
 void Projectile::draw() {
 	Entity::draw();
-	shape->setPosition(x + drawShiftX, y + drawShiftY);
+	shape->setPosition(x() + drawShiftX, y() + drawShiftY);
 	shape->setRotation(90.f + rotation);
 	shape->setFillColor(sf::Color(color[0], color[1], color[2]));
 	window->draw(*shape);
-	if (g_camera.scale > radius) {
+	if (g_camera.scale > radius()) {
 		g_camera.bindUI();
-		icon->setPosition(g_camera.w * 0.5 + (x - ownX) / g_camera.scale, g_camera.h * 0.5 + (y - ownY) / g_camera.scale);
+		icon->setPosition(g_camera.w * 0.5 + (x() - ownX) / g_camera.scale, g_camera.h * 0.5 + (y() - ownY) / g_camera.scale);
 		icon->setRotation(90.f + rotation);
 		window->draw(*icon);
 		if (target && ownEntity && target == ownEntity) {
-			warning->setPosition(g_camera.w * 0.5 + (x - ownX) / g_camera.scale, g_camera.h * 0.5 + (y - ownY) / g_camera.scale);
+			warning->setPosition(g_camera.w * 0.5 + (x() - ownX) / g_camera.scale, g_camera.h * 0.5 + (y() - ownY) / g_camera.scale);
 			window->draw(*warning);
 		}
 		g_camera.bindWorld();
 	}
 }
 
-void Projectile::onEntityDelete(Entity* d) {
-	Entity::onEntityDelete(d);
-	if (owner == d) {
-		owner = nullptr;
-	}
-	if (target == d) {
-		target = d->type() == Entities::Projectile && ((Projectile*)d)->owner != owner ? ((Projectile*)d)->owner : nullptr;
+void Projectile::setTarget(Entity* e) {
+	target = e;
+	if (e && e->type() == Entities::Projectile) {
+		((Projectile*)e)->chasers.push_back(this);
 	}
 }
 
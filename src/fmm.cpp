@@ -0,0 +1,265 @@
+#include "entities.hpp"
+#include "fmm.hpp"
+#include "globals.hpp"
+#include "physics.hpp"
+#include "quadtree.hpp"
+#include "threads.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace obf {
+
+// pull of everything accepted at or above a quad, as a third order expansion about the centre of its bodies
+struct LocalField {
+	double ax = 0.0, ay = 0.0;
+	double jxx = 0.0, jxy = 0.0, jyy = 0.0; // first derivatives
+	double hxxx = 0.0, hxxy = 0.0, hxyy = 0.0, hyyy = 0.0; // second derivatives
+	double txxxx = 0.0, txxxy = 0.0, txxyy = 0.0, txyyy = 0.0, tyyyy = 0.0; // third derivatives
+};
+
+// where the bodies under a quad are now, they have moved since the tree was built and the expansions only hold close to them
+struct Extent {
+	double x, y, size; // centre and larger side
+};
+
+static std::vector<LocalField> locals;
+static std::vector<Extent> extents;
+static std::vector<std::array<double, 4>> boxes;
+static std::vector<uint32_t> frontier, nextFrontier;
+static std::vector<uint8_t> anyDue; // whether any body under a quad is due, quads without one are skipped as sinks
+
+// per thread scratch for fmmAttractFrom()
+struct FmmScratch {
+	std::vector<std::pair<uint32_t, uint32_t>> stack; // (sink, source) quad pairs still to look at
+	std::vector<std::pair<uint32_t, uint32_t>> direct; // (sink, source) leaf pairs too close for the expansions
+	std::vector<uint32_t> down;
+	std::vector<double> x, y, mass;
+	std::vector<uint32_t> near;
+};
+static thread_local FmmScratch scratch;
+
+// pull of a point mass at dx, dy from the expansion centre and its derivatives
+static void addField(LocalField& field, double mass, double dx, double dy) {
+	double inv2 = 1.0 / (dx * dx + dy * dy);
+	double m3 = mass * inv2 * std::sqrt(inv2), m5 = 3.0 * m3 * inv2, m7 = 5.0 * m5 * inv2, m9 = 7.0 * m7 * inv2;
+	field.ax += dx * m3;
+	field.ay += dy * m3;
+	field.jxx += m5 * dx * dx - m3;
+	field.jxy += m5 * dx * dy;
+	field.jyy += m5 * dy * dy - m3;
+	field.hxxx += (m7 * dx * dx - 3.0 * m5) * dx;
+	field.hxxy += (m7 * dx * dx - m5) * dy;
+	field.hxyy += (m7 * dy * dy - m5) * dx;
+	field.hyyy += (m7 * dy * dy - 3.0 * m5) * dy;
+	double dxx = dx * dx, dxy = dx * dy, dyy = dy * dy;
+	field.txxxx += m9 * dxx * dxx - 6.0 * m7 * dxx + 3.0 * m5;
+	field.txxxy += (m9 * dxx - 3.0 * m7) * dxy;
+	field.txxyy += m9 * dxx * dyy - m7 * (dxx + dyy) + m5;
+	field.txyyy += (m9 * dyy - 3.0 * m7) * dxy;
+	field.tyyyy += m9 * dyy * dyy - 6.0 * m7 * dyy + 3.0 * m5;
+}
+
+// value of the field at dx, dy from its centre
+static inline void evalField(const LocalField& field, double dx, double dy, double& ax, double& ay) {
+	double dxx = dx * dx, dxy = dx * dy, dyy = dy * dy;
+	ax = field.ax + field.jxx * dx + field.jxy * dy + 0.5 * (field.hxxx * dxx + 2.0 * field.hxxy * dxy + field.hxyy * dyy)
+	+ (field.txxxx * dxx * dx + 3.0 * field.txxxy * dxx * dy + 3.0 * field.txxyy * dx * dyy + field.txyyy * dyy * dy) / 6.0;
+	ay = field.ay + field.jxy * dx + field.jyy * dy + 0.5 * (field.hxxy * dxx + 2.0 * field.hxyy * dxy + field.hyyy * dyy)
+	+ (field.txxxy * dxx * dx + 3.0 * field.txxyy * dxx * dy + 3.0 * field.txyyy * dx * dyy + field.tyyyy * dyy * dy) / 6.0;
+}
+
+// every body of sink pulled by every body of the sources, as one list so the kernel gets long runs
+static void attractDirect(const Quad& sink, const std::pair<uint32_t, uint32_t>* sources, size_t count) {
+	FmmScratch& s = scratch;
+	s.x.clear();
+	s.y.clear();
+	s.mass.clear();
+	s.near.clear();
+	for (size_t j = 0; j < count; j++) {
+		const Quad& source = quadtree[sources[j].second];
+		for (uint32_t i = source.first; i < source.first + source.count; i++) {
+			uint32_t body = quadtreeBodies[i];
+			s.x.push_back(bodies.x[body]);
+			s.y.push_back(bodies.y[body]);
+			s.mass.push_back(bodies.mass[body]);
+			s.near.push_back(body);
+		}
+	}
+	for (uint32_t i = sink.first; i < sink.first + sink.count; i++) {
+		uint32_t b = quadtreeBodies[i];
+		if (!bodies.due[b]) {
+			continue;
+		}
+		double ax = 0.0, ay = 0.0;
+		sumAttraction(s.x.data(), s.y.data(), s.mass.data(), s.mass.size(), bodies.x[b], bodies.y[b], ax, ay);
+		bodies.accX[b] += ax * G;
+		bodies.accY[b] += ay * G;
+	}
+}
+
+// dual tree walk of the quads under sink against the whole tree
+static void fmmAttractFrom(uint32_t sink) {
+	FmmScratch& s = scratch;
+	// expansions don't converge for quads closer than their sizes, so don't go below 1
+	double accuracy = std::max(gravityAccuracy, 1.0);
+	s.stack.clear();
+	s.direct.clear();
+	s.stack.push_back({sink, 0});
+	while (!s.stack.empty()) {
+		auto [a, b] = s.stack.back();
+		s.stack.pop_back();
+		if (!anyDue[a]) {
+			continue;
+		}
+		Quad& A = quadtree[a];
+		Quad& B = quadtree[b];
+		const Extent& eA = extents[a];
+		const Extent& eB = extents[b];
+		double zx = eA.x, zy = eA.y;
+		if (std::abs(eB.x - zx) + std::abs(eB.y - zy) > accuracy * (eA.size + eB.size)) {
+			addField(locals[a], B.mass, B.comx - zx, B.comy - zy);
+			// quadrupoles only feed the constant term, their gradient is as small as the terms the expansion leaves out
+			sumQuadrupoles(&B.comx, &B.comy, &B.qxx, &B.qxy, &B.qyy, 1, zx, zy, locals[a].ax, locals[a].ay);
+			continue;
+		}
+		if (A.leaf && B.leaf) {
+			s.direct.push_back({a, b});
+			continue;
+		}
+		// open the bigger of the two
+		if (B.leaf || (!A.leaf && eA.size > eB.size)) {
+			for (uint32_t c : A.children) {
+				if (c != 0) {
+					s.stack.push_back({c, b});
+				}
+			}
+		} else {
+			for (uint32_t c : B.children) {
+				if (c != 0) {
+					s.stack.push_back({a, c});
+				}
+			}
+		}
+	}
+	std::sort(s.direct.begin(), s.direct.end());
+	for (size_t i = 0, j = 0; i < s.direct.size(); i = j) {
+		while (j < s.direct.size() && s.direct[j].first == s.direct[i].first) {
+			j++;
+		}
+		attractDirect(quadtree[s.direct[i].first], s.direct.data() + i, j - i);
+	}
+}
+
+// shifts local fields down to the leaves under quad and applies them to their bodies
+static void passDown(uint32_t quad) {
+	std::vector<uint32_t>& stack = scratch.down;
+	stack.clear();
+	stack.push_back(quad);
+	while (!stack.empty()) {
+		uint32_t at = stack.back();
+		stack.pop_back();
+		Quad& parent = quadtree[at];
+		LocalField& field = locals[at];
+		double zx = extents[at].x, zy = extents[at].y;
+		if (parent.leaf) {
+			for (uint32_t i = parent.first; i < parent.first + parent.count; i++) {
+				uint32_t b = quadtreeBodies[i];
+				if (!bodies.due[b]) {
+					continue;
+				}
+				double ax, ay;
+				evalField(field, bodies.x[b] - zx, bodies.y[b] - zy, ax, ay);
+				bodies.accX[b] += ax * G;
+				bodies.accY[b] += ay * G;
+			}
+			continue;
+		}
+		for (uint32_t c : parent.children) {
+			if (c == 0 || !anyDue[c]) {
+				continue;
+			}
+			LocalField& child = locals[c];
+			double dx = extents[c].x - zx, dy = extents[c].y - zy, ax, ay;
+			evalField(field, dx, dy, ax, ay);
+			child.ax += ax;
+			child.ay += ay;
+			double dxx = dx * dx, dxy = dx * dy, dyy = dy * dy;
+			child.jxx += field.jxx + field.hxxx * dx + field.hxxy * dy + 0.5 * (field.txxxx * dxx + 2.0 * field.txxxy * dxy + field.txxyy * dyy);
+			child.jxy += field.jxy + field.hxxy * dx + field.hxyy * dy + 0.5 * (field.txxxy * dxx + 2.0 * field.txxyy * dxy + field.txyyy * dyy);
+			child.jyy += field.jyy + field.hxyy * dx + field.hyyy * dy + 0.5 * (field.txxyy * dxx + 2.0 * field.txyyy * dxy + field.tyyyy * dyy);
+			child.hxxx += field.hxxx + field.txxxx * dx + field.txxxy * dy;
+			child.hxxy += field.hxxy + field.txxxy * dx + field.txxyy * dy;
+			child.hxyy += field.hxyy + field.txxyy * dx + field.txyyy * dy;
+			child.hyyy += field.hyyy + field.txyyy * dx + field.tyyyy * dy;
+			child.txxxx += field.txxxx;
+			child.txxxy += field.txxxy;
+			child.txxyy += field.txxyy;
+			child.txyyy += field.txyyy;
+			child.tyyyy += field.tyyyy;
+			stack.push_back(c);
+		}
+	}
+}
+
+void fmmAttract() {
+	if (!quadtree[0].used) [[unlikely]] {
+		return;
+	}
+	locals.assign(quadsConstructed, LocalField());
+	// children always come after their parent, so walking backwards goes bottom up
+	boxes.resize(quadsConstructed);
+	extents.resize(quadsConstructed);
+	anyDue.assign(quadsConstructed, 0);
+	for (int i = quadsConstructed - 1; i >= 0; i--) {
+		Quad& quad = quadtree[i];
+		std::array<double, 4>& box = boxes[i];
+		box = {+INFINITY, +INFINITY, -INFINITY, -INFINITY};
+		if (quad.leaf) {
+			for (uint32_t j = quad.first; j < quad.first + quad.count; j++) {
+				uint32_t b = quadtreeBodies[j];
+				box = {std::min(box[0], bodies.x[b]), std::min(box[1], bodies.y[b]), std::max(box[2], bodies.x[b]), std::max(box[3], bodies.y[b])};
+				anyDue[i] |= bodies.due[b];
+			}
+		} else {
+			for (uint32_t c : quad.children) {
+				if (c != 0) {
+					std::array<double, 4>& child = boxes[c];
+					box = {std::min(box[0], child[0]), std::min(box[1], child[1]), std::max(box[2], child[2]), std::max(box[3], child[3])};
+					anyDue[i] |= anyDue[c];
+				}
+			}
+		}
+		extents[i] = {(box[0] + box[2]) * 0.5, (box[1] + box[3]) * 0.5, std::max(box[2] - box[0], box[3] - box[1])};
+	}
+	// quads above the frontier never take part in far interactions, so only go as deep as the threads need
+	size_t parts = parallelParts(updateGroup.size());
+	frontier.assign(1, 0);
+	while (parts > 1 && frontier.size() < parts * 4) {
+		nextFrontier.clear();
+		for (uint32_t q : frontier) {
+			if (quadtree[q].leaf) {
+				nextFrontier.push_back(q);
+				continue;
+			}
+			for (uint32_t c : quadtree[q].children) {
+				if (c != 0) {
+					nextFrontier.push_back(c);
+				}
+			}
+		}
+		if (nextFrontier.size() == frontier.size()) {
+			break;
+		}
+		frontier.swap(nextFrontier);
+	}
+	parallelTasks(frontier.size(), [](size_t i) {
+		fmmAttractFrom(frontier[i]);
+		passDown(frontier[i]);
+	});
+}
+
+}
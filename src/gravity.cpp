@@ -0,0 +1,119 @@
+#include "entities.hpp"
+#include "globals.hpp"
+#include "gravity.hpp"
+#include "physics.hpp"
+#include "quadtree.hpp"
+#include "strings.hpp"
+#include "threads.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace obf {
+
+using gravityClock = std::chrono::steady_clock;
+
+// sources are summed a tile at a time so they stay in cache while every sink of a thread goes over them
+constexpr size_t directTile = 1024;
+// runs the way that isn't picked twice in a row every this many evaluations so its figure stays current
+// only the second run is timed, the first pays for a full tree build and cold caches
+constexpr uint64_t probeSpacing = 64;
+// direct sums of more pairs than this aren't run before their cost is known, about a millisecond each
+constexpr double maxProbePairs = 1 << 20;
+// and once it is, the direct sum is only probed while it's within this factor of the tree
+constexpr double probeReach = 4.0;
+
+static std::vector<uint32_t> dueSlots;
+// seconds per sink and source pair of the direct sum, and per body plus due body of a tree build and its walks, 0 until measured
+static double directPairTime = 0.0, treeUnitTime = 0.0;
+static uint64_t evaluations = 0, directEvaluations = 0;
+static bool pickedDirect = false, lastDirect = false;
+
+static void directAttract() {
+	size_t count = updateGroup.size();
+	parallelFor(dueSlots.size(), [count](size_t from, size_t to) {
+		const double* bx = bodies.x.data();
+		const double* by = bodies.y.data();
+		const double* bmass = bodies.mass.data();
+		for (size_t i = from; i < to; i++) {
+			bodies.accX[dueSlots[i]] = 0.0;
+			bodies.accY[dueSlots[i]] = 0.0;
+		}
+		// every body is a source, the body itself is skipped by the kernel for being at distance 0
+		for (size_t tile = 0; tile < count; tile += directTile) {
+			size_t tileCount = std::min(directTile, count - tile);
+			for (size_t i = from; i < to; i++) {
+				uint32_t b = dueSlots[i];
+				double ax = 0.0, ay = 0.0;
+				sumAttraction(bx + tile, by + tile, bmass + tile, tileCount, bx[b], by[b], ax, ay);
+				bodies.accX[b] += ax * G;
+				bodies.accY[b] += ay * G;
+			}
+		}
+	});
+}
+
+void findGravity() {
+	size_t count = updateGroup.size();
+	dueSlots.clear();
+	for (size_t i = 0; i < count; i++) {
+		if (bodies.due[i]) {
+			dueSlots.push_back(i);
+		}
+	}
+	bool direct = gravitySolver == "direct";
+	double pairs = (double)dueSlots.size() * count;
+	if (!direct && autoDirectGravity) {
+		if (directPairTime == 0.0) {
+			// measure both before picking, big systems never time the direct sum and stay on the tree
+			direct = pairs <= maxProbePairs;
+		} else if (treeUnitTime != 0.0) {
+			// a tree costs a build over every body and a walk per due body, the direct sum every due body against every body
+			double directCost = directPairTime * pairs, treeCost = treeUnitTime * (count + dueSlots.size());
+			// only switch when the other way is clearly faster so close figures don't flip it every tick
+			if (pickedDirect ? directCost > treeCost * 1.25 : directCost * 1.25 < treeCost) {
+				pickedDirect = !pickedDirect;
+			}
+			bool probe = evaluations % probeSpacing >= probeSpacing - 2 && (pickedDirect || directCost < treeCost * probeReach);
+			direct = pickedDirect != probe;
+		}
+	}
+	evaluations++;
+	gravityClock::time_point start = gravityClock::now();
+	if (direct) {
+		directAttract();
+		directEvaluations++;
+	} else {
+		buildQuadtree();
+		attractLeaves();
+	}
+	double seconds = std::chrono::duration<double>(gravityClock::now() - start).count();
+	bool warm = direct == lastDirect;
+	lastDirect = direct;
+	if (!warm) {
+		return;
+	}
+	if (direct && !dueSlots.empty()) {
+		double pairTime = seconds / (dueSlots.size() * count);
+		directPairTime = directPairTime == 0.0 ? pairTime : directPairTime * 0.75 + pairTime * 0.25;
+	} else if (!direct && count != 0) {
+		double unitTime = seconds / (count + dueSlots.size());
+		treeUnitTime = treeUnitTime == 0.0 ? unitTime : treeUnitTime * 0.75 + unitTime * 0.25;
+	}
+}
+
+void printGravityStats() {
+	char out[160];
+	// n * n pairs against n bodies plus n walks
+	double crossover = directPairTime == 0.0 ? 0.0 : 2.0 * treeUnitTime / directPairTime;
+	snprintf(out, sizeof(out), "%lu of %lu gravity evaluations direct, %.2fns per direct pair, %.2fns per tree body, direct is faster below ~%.0f bodies when all are due",
+	(unsigned long)directEvaluations, (unsigned long)evaluations, directPairTime * 1e9, treeUnitTime * 1e9, crossover);
+	printPreferred(out);
+	evaluations = 0;
+	directEvaluations = 0;
+}
+
+}
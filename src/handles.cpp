@@ -0,0 +1,59 @@
+#include "entities.hpp"
+#include "handles.hpp"
+
+namespace obf {
+
+EntityRef::EntityRef(Entity* e) {
+	if (e) {
+		*this = e->handle;
+	}
+}
+
+Entity* EntityRef::get() const {
+	if (index >= entityTable.entities.size() || entityTable.generations[index] != generation) {
+		return nullptr;
+	}
+	return entityTable.entities[index];
+}
+
+EntityRef EntityTable::add(Entity* e) {
+	EntityRef ref;
+	if (freeIndices.empty()) {
+		ref.index = entities.size();
+		entities.push_back(e);
+		generations.push_back(0);
+	} else {
+		ref.index = freeIndices.back();
+		freeIndices.pop_back();
+		entities[ref.index] = e;
+	}
+	ref.generation = generations[ref.index];
+	// ids of local entities can clash with ones the server already gave out until they are replaced, keep the first
+	ids.try_emplace(e->id, ref.index);
+	return ref;
+}
+
+void EntityTable::remove(EntityRef ref) {
+	auto it = ids.find(entities[ref.index]->id);
+	if (it != ids.end() && it->second == ref.index) {
+		ids.erase(it);
+	}
+	entities[ref.index] = nullptr;
+	generations[ref.index]++;
+	freeIndices.push_back(ref.index);
+}
+
+void EntityTable::changeId(Entity* e, uint32_t oldId) {
+	auto it = ids.find(oldId);
+	if (it != ids.end() && it->second == e->handle.index) {
+		ids.erase(it);
+	}
+	ids[e->id] = e->handle.index;
+}
+
+Entity* EntityTable::byId(uint32_t id) const {
+	auto it = ids.find(id);
+	return it == ids.end() ? nullptr : entities[it->second];
+}
+
+}
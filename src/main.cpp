@@ -4,6 +4,9 @@
 #include "globals.hpp"
 #include "math.hpp"
 #include "net.hpp"
+#include "physics.hpp"
+#include "predict.hpp"
+#include "threads.hpp"
 #include "types.hpp"
 #include "ui.hpp"
 #include "strings.hpp"
@@ -21,6 +24,7 @@
 #include <iostream>
 #include <regex>
 #include <thread>
+#include <utility>
 
 using namespace obf;
 
@@ -33,6 +37,94 @@ void inputListen() {
 	inputWaiting = false;
 }
 
+// one fixed step of the simulation, delta is the tick length
+void physicsTick() {
+	if (!headless && ownEntity) {
+		if (lockControls) {
+			unsigned char zero = 0;
+			ownEntity->control(*(movement*)&zero);
+		} else {
+			ownEntity->control(controls);
+		}
+	}
+	if (isServer) {
+		for (Player* player : playerGroup) {
+			if (player->entity) {
+				player->entity->control(player->controls);
+			}
+		}
+	}
+	updateEntities();
+	simTime += delta;
+	// moved with the stars every tick, its velocity lets the drawn bodies' interpolation carry it along too
+	if (systemCenter && !stars.empty()) {
+		double x = 0.0, y = 0.0, velX = 0.0, velY = 0.0;
+		for (CelestialBody* star : stars) {
+			x += star->x();
+			y += star->y();
+			velX += star->velX();
+			velY += star->velY();
+		}
+		systemCenter->setPosition(x / stars.size(), y / stars.size());
+		systemCenter->setVelocity(velX / stars.size(), velY / stars.size());
+	}
+
+	if (authority && lastSweep + projectileSweepSpacing < globalTime) {
+		for (Entity* e : updateGroup) {
+			if (e->type() != Entities::Projectile) {
+				continue;
+			}
+			double closest = DBL_MAX;
+			if (isServer) {
+				for (Player* p : playerGroup) {
+					if (!p->entity) {
+						continue;
+					}
+					closest = std::min(closest, dst2(e->x() - p->entity->x(), e->y() - p->entity->y()));
+				}
+			} else {
+				if (ownEntity) {
+					closest = dst2(e->x() - ownEntity->x(), e->y() - ownEntity->y());
+				} else {
+					break;
+				}
+			}
+			if (closest > sweepThreshold) {
+				e->active = false;
+			}
+		}
+		lastSweep = globalTime;
+	}
+	std::vector<Entity*> deleted;
+	for (Entity* e : updateGroup) {
+		if (!e->active) [[unlikely]] {
+			deleted.push_back(e);
+		}
+	}
+	if (!deleted.empty()) [[unlikely]] {
+		// one pass each no matter how many went away, references to them are weak so nothing else needs to know
+		auto inactive = [](Entity* e) {
+			return !e->active;
+		};
+		std::erase_if(updateGroup, inactive);
+		std::erase_if(stars, inactive);
+		std::erase_if(planets, inactive);
+		if (spareTrajectories.size() > updateGroup.size()) {
+			spareTrajectories.resize(updateGroup.size());
+		}
+	}
+	for (Entity* d : deleted) {
+		if (isServer) {
+			for (Player* p : playerGroup) {
+				sf::Packet despawnPacket;
+				despawnPacket << Packets::DeleteEntity << d->id;
+				p->tcpSocket.send(despawnPacket);
+			}
+		}
+		delete d;
+	}
+}
+
 int main(int argc, char** argv) {
 	bool regenConfig = false;
 	for (int i = 1; i < argc; i++) {
@@ -51,10 +143,31 @@ int main(int argc, char** argv) {
 		out << "port: Used both as the port to host on and to specify port for autoConnect if server address does not contain port (short uint)" << std::endl;
 		out << "predictDelta: As a client, how many ticks to advance every prediction simulation step (double)" << std::endl;
 		out << "predictSpacing: As a client, how many seconds to wait between trajectory prediction simulations (double)" << std::endl;
+		out << "predictTolerance: As a client, how many meters bodies can end up from where the last prediction has them before it's redone from scratch instead of only being extended (double)" << std::endl;
+		out << "predictRefresh: As a client, most seconds of game time to keep extending a prediction for before it's redone from scratch anyway (double)" << std::endl;
+		out << "predictIntegrator: As a client, how to step trajectory prediction, leapfrog - fixed steps of [predictDelta], adaptive - Dormand-Prince with steps as long as [predictAccuracy] allows for each light body, sampled back onto [predictDelta] (string)" << std::endl;
+		out << "predictAccuracy: As a client, most meters of error per second predicted an adaptive prediction step may make (double)" << std::endl;
+		out << "conicThreshold: As a client, bodies coasting around the reference body get their trajectory drawn as an exact orbit instead of predicted step by step while the pull of everything else on them stays below this fraction of the reference's, 0 never does (double)" << std::endl;
+		out << "reducedPrediction: As a client, only predict the celestial bodies, your own ship and the reference body, much cheaper but other ships get no trajectories (bool)" << std::endl;
 		out << "NOTE: any clients will have to have the same physics-related configs as the server for them to work properly" << std::endl;
 		out << "friction: Friction of touching bodies (double)" << std::endl;
 		out << "collideRestitution: How bouncy collisions are (double)" << std::endl;
 		out << "gravityStrength: How strong gravity is (double)" << std::endl;
+		out << "physicsRate: How many fixed physics ticks to run per real second, each moves timescale / physicsRate seconds of game time, 0 steps once per frame instead (double)" << std::endl;
+		out << "maxTicksPerFrame: Most physics ticks to run in a single frame when catching up, time beyond that is dropped so a slow machine runs slow instead of stalling (int)" << std::endl;
+		out << "gravitySolver: tree - Barnes-Hut walk per quadtree leaf, fmm - quads interact with each other and pass their pull down to their bodies, scales better with many bodies, direct - every body pulls every other directly, only fast with few bodies (string)" << std::endl;
+		out << "autoDirectGravity: Whether to time direct gravity against gravitySolver as the game runs and use whichever is faster, the two give slightly different results so runs stop being repeatable and clients drift from the server, off by default (bool)" << std::endl;
+		out << "integrator: euler - move then apply gravity, cheapest but orbits drift, leapfrog - half of the gravity before moving and half after, keeps orbits stable at longer ticks, yoshida - three leapfrog steps per tick, 4th order so physicsRate can go much lower for the same accuracy at about 3 times the gravity work per tick (string)" << std::endl;
+		out << "blockLevels: Bodies whose velocity gravity changes slowly only have their gravity found every 2, 4, 8... ticks, this is the most doublings allowed, 0 finds it for every body every tick, not used with yoshida (int)" << std::endl;
+		out << "blockAccuracy: Fraction of a body's velocity gravity may change it by between its gravity updates, lower is more accurate with fewer bodies on long steps (double)" << std::endl;
+		out << "farFieldInterval: With the tree solver, how many ticks the pull of far away quads is kept for before it's found again, nearby gravity is still found every tick, 1 or less finds everything every time (int)" << std::endl;
+		out << "farFieldAccuracy: How many of their sizes away quads have to be to count as far away for farFieldInterval, has to be below gravityAccuracy, use the farerror command to see what it costs (double)" << std::endl;
+		out << "gravityQuadrupoles: Whether far away groups of bodies also pull with their quadrupole moment, more accurate for the same gravityAccuracy so it can be lowered (bool)" << std::endl;
+		out << "testParticleMassRatio: Bodies lighter than this fraction of the heaviest body are left out of the gravity quadtree, they are still pulled by everything else but don't pull on anything (double)" << std::endl;
+		out << "quadtreeBucketSize: How many bodies a gravity quadtree leaf can hold, bodies in a leaf share one tree walk (int)" << std::endl;
+		out << "quadtreeRefit: Whether the gravity quadtree is only refitted around moved bodies while the same bodies exist, instead of rebuilt every tick (bool)" << std::endl;
+		out << "quadtreeRefitLimit: How much the quadtree leaves may grow from refitting before it gets rebuilt, as a multiple of their size at the last build (double)" << std::endl;
+		out << "quadtreeShrinkDelay: How many builds in a row the gravity quadtree has to stay small for before its spare memory is given back (int)" << std::endl;
 		out << "syncSpacing: As a server, how often should clients be synced (double)" << std::endl;
 		out << "gen_blackholeChance: As a server, what fraction of stars should instead be black holes (double)" << std::endl;
 		out << "gen_extraStarChance: As a server, the chance for an additional star to generate after the previous (double)" << std::endl;
@@ -65,6 +178,8 @@ int main(int argc, char** argv) {
 		out << "autorestart: As a server, whether to periodically regenerate the solar system (bool)" << std::endl;
 		out << "autoConnect: As a client, whether to automatically connect to a server (bool)" << std::endl;
 		out << "enableControlLock: As a client, whether to enable using LAlt to lock controls (bool)" << std::endl;
+		out << "updateThreadCount: How many threads to run entity updates on, the threads are kept alive between ticks (int)" << std::endl;
+		out << "minThreadEntities: Smallest amount of entities to hand to a single update thread, use the threadstats command to tune (int)" << std::endl;
 		out << "DEBUG: Whether to enable debug mode, prints extra info to console (bool)" << std::endl;
 		if(regenConfig) {
 			return 0;
@@ -152,6 +267,7 @@ int main(int argc, char** argv) {
 			if (autorestart) {
 				if (playerGroup.size() == 0) {
 					delta = 0.0;
+					tickAccumulator = 0.0;
 					lastAutorestartNotif = -autorestartNotifSpacing;
 					lastAutorestart = globalTime;
 					if (!autorestartRegenned) {
@@ -162,6 +278,7 @@ int main(int argc, char** argv) {
 				} else {
 					if (lastAutorestart + autorestartSpacing < globalTime) {
 						delta = 0.0;
+						tickAccumulator = 0.0;
 						fullClear(false);
 						generateSystem();
 						for (Entity* e : updateGroup) {
@@ -292,7 +409,7 @@ int main(int argc, char** argv) {
 								if (e == ownEntity) {
 									continue;
 								}
-								double dst = dst2(e->x - ownX - (mousePos.x - g_camera.w * 0.5) * g_camera.scale, e->y - ownY - (mousePos.y - g_camera.h * 0.5) * g_camera.scale) - e->radius * e->radius;
+								double dst = dst2(e->x() - ownX - (mousePos.x - g_camera.w * 0.5) * g_camera.scale, e->y() - ownY - (mousePos.y - g_camera.h * 0.5) * g_camera.scale) - e->radius() * e->radius();
 								if (dst < minDst) {
 									minDst = dst;
 									closestEntity = e;
@@ -313,13 +430,13 @@ int main(int argc, char** argv) {
 						double minDst = DBL_MAX;
 						Entity* closestEntity = nullptr;
 						for (Entity* e : updateGroup) {
-							double dst = dst2(e->x - ownX - (mousePos.x - g_camera.w * 0.5) * g_camera.scale, e->y - ownY - (mousePos.y - g_camera.h * 0.5) * g_camera.scale) - e->radius * e->radius;
+							double dst = dst2(e->x() - ownX - (mousePos.x - g_camera.w * 0.5) * g_camera.scale, e->y() - ownY - (mousePos.y - g_camera.h * 0.5) * g_camera.scale) - e->radius() * e->radius();
 							if (dst < minDst) {
 								minDst = dst;
 								closestEntity = e;
 							}
 						}
-						if (dst2(systemCenter->x - ownX - (mousePos.x - g_camera.w * 0.5) * g_camera.scale, systemCenter->y - ownY - (mousePos.y - g_camera.h * 0.5) * g_camera.scale) < minDst) {
+						if (dst2(systemCenter->x() - ownX - (mousePos.x - g_camera.w * 0.5) * g_camera.scale, systemCenter->y() - ownY - (mousePos.y - g_camera.h * 0.5) * g_camera.scale) < minDst) {
 							closestEntity = systemCenter;
 						}
 						if (closestEntity == trajectoryRef) {
@@ -343,15 +460,20 @@ int main(int argc, char** argv) {
 				}
 			}
 			window->clear(sf::Color(16, 0, 32));
+			// draw bodies where they were partway through the tick that's in progress instead of where the last tick left them
+			bool interpolate = deltaOverride <= 0.0 && physicsRate > 0.0;
+			if (interpolate) {
+				interpolateBodies(tickAccumulator * physicsRate - 1.0, timescale / physicsRate);
+			}
 			if (ownEntity) [[likely]] {
-				ownX = ownEntity->x;
-				ownY = ownEntity->y;
+				ownX = ownEntity->x();
+				ownY = ownEntity->y();
 				drawShiftX = -ownX, drawShiftY = -ownY;
 			}
 			g_camera.bindWorld();
 			g_camera.pos.x = 0;
 			g_camera.pos.y = 0;
-			trajectoryOffset = floor((globalTime - lastPredict) / predictDelta);
+			trajectoryOffset = floor((simTime - predictedFrom) / predictDelta);
 			for (size_t i = 0; i < ghostTrajectories.size(); i++) {
 				std::vector<Point>& traj = ghostTrajectories[i];
 				if (lastTrajectoryRef && traj.size() > 0) [[likely]] {
@@ -361,7 +483,7 @@ int main(int argc, char** argv) {
 					float decBy = (255.f - 64.f) / traj.size();
 					for (size_t i = 0; i < traj.size(); i++) {
 						Point point = traj[i];
-						lines[i].position = sf::Vector2f(lastTrajectoryRef->x + point.x + drawShiftX, lastTrajectoryRef->y + point.y + drawShiftY);
+						lines[i].position = sf::Vector2f(lastTrajectoryRef->x() + point.x + drawShiftX, lastTrajectoryRef->y() + point.y + drawShiftY);
 						lines[i].color = trajColor;
 						lines[i].color.a = lastAlpha;
 						lastAlpha -= decBy;
@@ -369,33 +491,15 @@ int main(int argc, char** argv) {
 					window->draw(lines);
 				}
 			}
-			if (!stars.empty()) {
-				double x = 0.0, y = 0.0;
-				for (CelestialBody* star : stars) {
-					x += star->x;
-					y += star->y;
-				}
-				x /= stars.size();
-				y /= stars.size();
-				systemCenter->setPosition(x, y);
-			}
 			for (size_t i = 0; i < updateGroup.size(); i++) {
 				updateGroup[i]->draw();
 			}
-			if (ownEntity) {
-				if (lockControls) {
-					unsigned char zero = 0;
-					ownEntity->control(*(movement*)&zero);
-				} else {
-					ownEntity->control(controls);
-				}
-			}
 			g_camera.bindUI();
 			if (lastTrajectoryRef) {
-				float radius = std::max(5.f, (float)(lastTrajectoryRef->radius / g_camera.scale));
+				float radius = std::max(5.f, (float)(lastTrajectoryRef->radius() / g_camera.scale));
 				sf::CircleShape selection(radius, 4);
 				selection.setOrigin(radius, radius);
-				selection.setPosition(g_camera.w * 0.5 + (lastTrajectoryRef->x - ownX) / g_camera.scale, g_camera.h * 0.5 + (lastTrajectoryRef->y - ownY) / g_camera.scale);
+				selection.setPosition(g_camera.w * 0.5 + (lastTrajectoryRef->x() - ownX) / g_camera.scale, g_camera.h * 0.5 + (lastTrajectoryRef->y() - ownY) / g_camera.scale);
 				selection.setFillColor(sf::Color(0, 0, 0, 0));
 				selection.setOutlineColor(sf::Color(255, 255, 64));
 				selection.setOutlineThickness(1.f);
@@ -403,10 +507,10 @@ int main(int argc, char** argv) {
 			}
 			if (ownEntity && ((Triangle*)ownEntity)->target != nullptr) {
 				Entity* target = ((Triangle*)ownEntity)->target;
-				float radius = std::max(5.f, (float)(target->radius / g_camera.scale));
+				float radius = std::max(5.f, (float)(target->radius() / g_camera.scale));
 				sf::CircleShape selection(radius, 3);
 				selection.setOrigin(radius, radius);
-				selection.setPosition(g_camera.w * 0.5 + (target->x - ownX) / g_camera.scale, g_camera.h * 0.5 + (target->y - ownY) / g_camera.scale);
+				selection.setPosition(g_camera.w * 0.5 + (target->x() - ownX) / g_camera.scale, g_camera.h * 0.5 + (target->y() - ownY) / g_camera.scale);
 				selection.setFillColor(sf::Color(0, 0, 0, 0));
 				selection.setOutlineColor(sf::Color(255, 0, 0));
 				selection.setOutlineThickness(1.f);
@@ -422,6 +526,9 @@ int main(int argc, char** argv) {
 			}
 			g_camera.bindWorld();
 			window->display();
+			if (interpolate) {
+				restoreBodies();
+			}
 
 			if (serverSocket) {
 				sf::Socket::Status status = sf::Socket::Done;
@@ -449,158 +556,26 @@ int main(int argc, char** argv) {
 			}
 		}
 
-		buildQuadtree();
-		for (Entity* e : updateGroup) {
-			e->update1();
-		}
-		updateEntities();
-
-		if (authority && lastSweep + projectileSweepSpacing < globalTime) {
-			for (Entity* e : updateGroup) {
-				if (e->type() != Entities::Projectile) {
-					continue;
-				}
-				double closest = DBL_MAX;
-				if (isServer) {
-					for (Player* p : playerGroup) {
-						if (!p->entity) {
-							continue;
-						}
-						closest = std::min(closest, dst2(e->x - p->entity->x, e->y - p->entity->y));
-					}
-				} else {
-					if (ownEntity) {
-						closest = dst2(e->x - ownEntity->x, e->y - ownEntity->y);
-					} else {
-						break;
-					}
-				}
-				if (closest > sweepThreshold) {
-					e->active = false;
-				}
-			}
-			lastSweep = globalTime;
-		}
-		std::vector<Entity*> deleted;
-		for (size_t i = 0; i < updateGroup.size(); i++) {
-			if (!updateGroup[i]->active) [[unlikely]] {
-				deleted.push_back(updateGroup[i]);
-				updateGroup.erase(updateGroup.begin() + i);
-				i--;
-			}
-		}
-		for (Entity* d : deleted) {
-			for (size_t i = 0; i < EntityDeleteListener::listeners.size(); i++) {
-				EntityDeleteListener::listeners[i]->onEntityDelete(d);
-			}
-			if (d->type() == Entities::CelestialBody) {
-				for (size_t i = 0; i < stars.size(); i++) {
-					Entity* e = stars[i];
-					if (e == d) [[unlikely]] {
-						stars[i] = stars[stars.size() - 1];
-						stars.pop_back();
-						break;
-					}
-				}
-				for (size_t i = 0; i < planets.size(); i++) {
-					Entity* e = planets[i];
-					if (e == d) [[unlikely]] {
-						planets[i] = planets[planets.size() - 1];
-						planets.pop_back();
-						break;
-					}
-				}
-			}
-			if (isServer) {
-				for (Player* p : playerGroup) {
-					sf::Packet despawnPacket;
-					despawnPacket << Packets::DeleteEntity << d->id;
-					p->tcpSocket.send(despawnPacket);
+		// physics runs in fixed ticks of 1 / physicsRate real seconds whatever the frame rate, leftover time carries over
+		if (deltaOverride > 0.0 || physicsRate <= 0.0) {
+			physicsTick();
+		} else {
+			delta = timescale / physicsRate;
+			for (int ticks = 0; tickAccumulator * physicsRate >= 1.0; ticks++) {
+				if (ticks == maxTicksPerFrame) {
+					// too far behind to catch up, let the simulation slow down instead
+					tickAccumulator = 0.0;
+					break;
 				}
+				physicsTick();
+				tickAccumulator -= 1.0 / physicsRate;
 			}
-			if (d == lastTrajectoryRef) {
-				lastTrajectoryRef = nullptr;
-			}
-			if (d == trajectoryRef) {
-				trajectoryRef = nullptr;
-			}
-			delete d;
 		}
-		deleted.clear();
-		if (!headless && globalTime - lastPredict > predictSpacing && trajectoryRef) [[unlikely]] {
-			double resdelta = delta;
-			double resTime = globalTime;
-			bool resAuthority = authority;
-			authority = true;
-			std::vector<Entity*> retUpdateGroup(updateGroup);
-			delta = predictDelta;
-			simulating = true;
-			ghostTrajectories.clear();
-			ghostTrajectoryColors.clear();
-			bool controlsActive = *(unsigned char*) &controls != 0;
-			Triangle* ghost = nullptr;
-			if (ownEntity && controlsActive) {
-				ghost = new Triangle();
-				ghost->x = ownEntity->x;
-				ghost->y = ownEntity->y;
-				ghost->velX = ownEntity->velX;
-				ghost->velY = ownEntity->velY;
-				ghost->parent_id = ownEntity->id;
-				std::copy(std::begin(ownEntity->color), std::end(ownEntity->color), std::begin(ghost->color));
-				simCleanupBuffer.push_back(ghost);
-			}
-			for (Entity* e : updateGroup) {
-				e->simSetup();
-				e->trajectory.clear();
-			}
-			for (int i = 0; i < predictSteps; i++) {
-				predictingFor = predictDelta * predictSteps;
-				globalTime += predictDelta;
-				buildQuadtree();
-				for (Entity* e : updateGroup) {
-					e->update1();
-				}
-				updateEntities();
-				if (!stars.empty()) [[likely]] {
-					double x = 0.0, y = 0.0;
-					for (CelestialBody* star : stars) {
-						x += star->x;
-						y += star->y;
-					}
-					x /= stars.size();
-					y /= stars.size();
-					systemCenter->setPosition(x, y);
-				}
-				for (Entity* e : updateGroup) {
-					e->trajectory.push_back({e->x - trajectoryRef->x, e->y - trajectoryRef->y});
-				}
-				if (ownEntity) {
-					ownEntity->control(controls);
-				}
-				for (size_t i = 0; i < updateGroup.size(); i++) {
-					if (!updateGroup[i]->active) [[unlikely]] {
-						updateGroup[i]->active = true;
-						updateGroup.erase(updateGroup.begin() + i);
-						i--;
-					}
-				}
-			}
-			for (Entity* en : simCleanupBuffer) {
-				ghostTrajectories.push_back(en->trajectory);
-				ghostTrajectoryColors.push_back(sf::Color(en->color[0] * 0.7, en->color[1] * 0.7, en->color[2] * 0.7));
-				en->active = false;
-			}
-			simCleanupBuffer.clear();
-			updateGroup = retUpdateGroup;
-			for (Entity* e : updateGroup) {
-				e->simReset();
+		if (!headless) {
+			collectPrediction();
+			if (globalTime - lastPredict > predictSpacing && trajectoryRef) [[unlikely]] {
+				startPrediction();
 			}
-			delta = resdelta;
-			simulating = false;
-			authority = resAuthority;
-			globalTime = resTime;
-			lastPredict = globalTime;
-			lastTrajectoryRef = trajectoryRef;
 		}
 		if (isServer) {
 			int to = playerGroup.size();
@@ -660,7 +635,7 @@ int main(int argc, char** argv) {
 				if (globalTime - player->lastSynced > syncSpacing) {
 					bool fullsync = globalTime - player->lastFullsynced > fullsyncSpacing;
 					for (Entity* e : updateGroup) {
-						if (player->entity && !fullsync && (std::abs(e->y - player->entity->y) - syncCullOffset > player->viewH * syncCullThreshold || std::abs(e->x - player->entity->x) - syncCullOffset > player->viewW * syncCullThreshold)) {
+						if (player->entity && !fullsync && (std::abs(e->y() - player->entity->y()) - syncCullOffset > player->viewH * syncCullThreshold || std::abs(e->x() - player->entity->x()) - syncCullOffset > player->viewW * syncCullThreshold)) {
 							continue;
 						}
 						sf::Packet packet;
@@ -677,16 +652,12 @@ int main(int argc, char** argv) {
 					}
 				}
 
-				if (player->entity) {
-					player->entity->control(player->controls);
-				}
-
 			egg:
 				continue;
 			}
 		}
 
-		delta = deltaClock.restart().asSeconds();
+		double frameTime = deltaClock.restart().asSeconds();
 		measureFrames++;
 		if (globalTime > lastShowFramerate + 1.0) {
 			lastShowFramerate = globalTime;
@@ -698,8 +669,10 @@ int main(int argc, char** argv) {
 		actualDeltaClock.restart();
 		if (deltaOverride > 0.0) {
 			delta = deltaOverride;
+		} else if (physicsRate <= 0.0) {
+			delta = frameTime * timescale;
 		} else {
-			delta *= timescale;
+			tickAccumulator += frameTime;
 		}
 		globalTime = globalClock.getElapsedTime().asSeconds();
 	}
@@ -54,10 +54,13 @@ void clientParsePacket(sf::Packet& packet) {
         if (debug) [[unlikely]] {
             printf("Received entity of type %u\n", entityType);
         }
+        // the entity is made with a local id first and then takes the one in the packet
+        uint32_t localID = nextID;
         switch (entityType) {
         case Entities::Triangle: {
             Triangle* e = new Triangle;
             e->unloadCreatePacket(packet);
+            entityTable.changeId(e, localID);
             break;
         }
         case Entities::CelestialBody: {
@@ -68,6 +71,7 @@ void clientParsePacket(sf::Packet& packet) {
             }
             CelestialBody* e = new CelestialBody(radius);
             e->unloadCreatePacket(packet);
+            entityTable.changeId(e, localID);
             if (e->star) {
                 stars.push_back(e);
             }
@@ -76,6 +80,7 @@ void clientParsePacket(sf::Packet& packet) {
         case Entities::Projectile: {
             Projectile* e = new Projectile;
             e->unloadCreatePacket(packet);
+            entityTable.changeId(e, localID);
             break;
         }
         default:
@@ -101,10 +106,10 @@ void clientParsePacket(sf::Packet& packet) {
             if (!e->synced) {
                 continue;
             }
-            e->x = e->syncX;
-            e->y = e->syncY;
-            e->velX = e->syncVelX;
-            e->velY = e->syncVelY;
+            e->x() = e->syncX;
+            e->y() = e->syncY;
+            e->velX() = e->syncVelX;
+            e->velY() = e->syncVelY;
             e->synced = false;
         }
         break;
@@ -156,9 +161,9 @@ void clientParsePacket(sf::Packet& packet) {
         packet >> entityID;
         CelestialBody* e = (CelestialBody*)idLookup(entityID);
         if (e) [[likely]] {
-            packet >> e->mass >> e->radius;
-            e->shape->setRadius(e->radius);
-            e->shape->setOrigin(e->radius, e->radius);
+            packet >> e->mass() >> e->radius();
+            e->shape->setRadius(e->radius());
+            e->shape->setOrigin(e->radius(), e->radius());
         } else {
             printf("Server has referred to invalid entity %u in packet of type %u.\n", entityID, type);
         }
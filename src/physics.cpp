@@ -0,0 +1,290 @@
+#include "entities.hpp"
+#include "globals.hpp"
+#include "physics.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define OBF_X86
+#endif
+
+namespace obf {
+
+uint32_t BodyStore::add(Entity* e) {
+	x.push_back(0.0);
+	y.push_back(0.0);
+	velX.push_back(0.0);
+	velY.push_back(0.0);
+	dVelX.push_back(0.0);
+	dVelY.push_back(0.0);
+	accX.push_back(0.0);
+	accY.push_back(0.0);
+	level.push_back(unsetLevel);
+	due.push_back(0);
+	farAccX.push_back(0.0);
+	farAccY.push_back(0.0);
+	farTick.push_back(std::numeric_limits<uint64_t>::max());
+	mass.push_back(0.0);
+	radius.push_back(0.0);
+	owner.push_back(e);
+	generation++;
+	return owner.size() - 1;
+}
+
+void BodyStore::remove(uint32_t slot) {
+	uint32_t last = owner.size() - 1;
+	if (slot != last) {
+		swap(slot, last);
+	}
+	x.pop_back();
+	y.pop_back();
+	velX.pop_back();
+	velY.pop_back();
+	dVelX.pop_back();
+	dVelY.pop_back();
+	accX.pop_back();
+	accY.pop_back();
+	level.pop_back();
+	due.pop_back();
+	farAccX.pop_back();
+	farAccY.pop_back();
+	farTick.pop_back();
+	mass.pop_back();
+	radius.pop_back();
+	owner.pop_back();
+	generation++;
+}
+
+void BodyStore::swap(uint32_t a, uint32_t b) {
+	std::swap(x[a], x[b]);
+	std::swap(y[a], y[b]);
+	std::swap(velX[a], velX[b]);
+	std::swap(velY[a], velY[b]);
+	std::swap(dVelX[a], dVelX[b]);
+	std::swap(dVelY[a], dVelY[b]);
+	std::swap(accX[a], accX[b]);
+	std::swap(accY[a], accY[b]);
+	std::swap(level[a], level[b]);
+	std::swap(due[a], due[b]);
+	std::swap(farAccX[a], farAccX[b]);
+	std::swap(farAccY[a], farAccY[b]);
+	std::swap(farTick[a], farTick[b]);
+	std::swap(mass[a], mass[b]);
+	std::swap(radius[a], radius[b]);
+	std::swap(owner[a], owner[b]);
+	owner[a]->slot = a;
+	owner[b]->slot = b;
+}
+
+size_t BodyStore::size() const {
+	return owner.size();
+}
+
+void syncBodies() {
+	Entity** group = updateGroup.data();
+	Entity** owners = bodies.owner.data();
+	for (size_t i = 0; i < updateGroup.size(); i++) {
+		// updateGroup has no duplicates, so the wanted body is never in an already placed slot
+		if (owners[i] != group[i]) [[unlikely]] {
+			bodies.swap(i, group[i]->slot);
+		}
+	}
+}
+
+void moveBodies(size_t from, size_t to, double step) {
+	double* x = bodies.x.data();
+	double* y = bodies.y.data();
+	const double* velX = bodies.velX.data();
+	const double* velY = bodies.velY.data();
+	double* dVelX = bodies.dVelX.data();
+	double* dVelY = bodies.dVelY.data();
+	for (size_t i = from; i < to; i++) {
+		dVelX[i] = velX[i] * step;
+		dVelY[i] = velY[i] * step;
+		x[i] += dVelX[i];
+		y[i] += dVelY[i];
+	}
+}
+
+void markDueBodies(size_t from, size_t to, uint64_t tick) {
+	const uint8_t* level = bodies.level.data();
+	uint8_t* due = bodies.due.data();
+	for (size_t i = from; i < to; i++) {
+		due[i] = level[i] == unsetLevel || (tick & ((uint64_t(1) << level[i]) - 1)) == 0;
+	}
+}
+
+void kickBodies(size_t from, size_t to, double step) {
+	double* velX = bodies.velX.data();
+	double* velY = bodies.velY.data();
+	const double* accX = bodies.accX.data();
+	const double* accY = bodies.accY.data();
+	const uint8_t* level = bodies.level.data();
+	const uint8_t* due = bodies.due.data();
+	for (size_t i = from; i < to; i++) {
+		if (due[i]) {
+			double blockStep = step * double(uint64_t(1) << level[i]);
+			velX[i] += accX[i] * blockStep;
+			velY[i] += accY[i] * blockStep;
+		}
+	}
+}
+
+void levelBodies(size_t from, size_t to, double step, uint64_t tick, int maxLevel) {
+	for (size_t i = from; i < to; i++) {
+		if (!bodies.due[i]) {
+			continue;
+		}
+		// time for gravity to change the velocity by blockAccuracy of itself, in ticks
+		double acc = dst(bodies.accX[i], bodies.accY[i]);
+		double ticks = acc == 0.0 ? INFINITY : blockAccuracy * dst(bodies.velX[i], bodies.velY[i]) / (acc * step);
+		int want = 0;
+		while (want < maxLevel && ticks >= double(uint64_t(2) << want)) {
+			want++;
+		}
+		int level = bodies.level[i] == unsetLevel ? 0 : bodies.level[i];
+		if (want > level && (tick & ((uint64_t(2) << level) - 1)) == 0) {
+			level++;
+		} else if (want < level) {
+			level = want;
+		}
+		bodies.level[i] = level;
+	}
+}
+
+static std::vector<double> drawnX, drawnY;
+
+void interpolateBodies(double fraction, double tickDelta) {
+	drawnX = bodies.x;
+	drawnY = bodies.y;
+	double step = fraction * tickDelta;
+	for (size_t i = 0; i < bodies.size(); i++) {
+		bodies.x[i] += bodies.velX[i] * step;
+		bodies.y[i] += bodies.velY[i] * step;
+	}
+}
+
+void restoreBodies() {
+	bodies.x.swap(drawnX);
+	bodies.y.swap(drawnY);
+}
+
+static void sumAttractionScalar(const double* x, const double* y, const double* mass, size_t count, double px, double py, double& ax, double& ay) {
+	double sumx = 0.0, sumy = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		double dx = x[i] - px, dy = y[i] - py;
+		double d2 = dx * dx + dy * dy;
+		if (d2 > 0.0) [[likely]] {
+			double inv = 1.0 / std::sqrt(d2);
+			double factor = mass[i] * inv * inv * inv;
+			sumx += dx * factor;
+			sumy += dy * factor;
+		}
+	}
+	ax += sumx;
+	ay += sumy;
+}
+
+#ifdef OBF_X86
+// rsqrt only exists for floats, it's good to ~12 bits so two newton steps in double bring it close to full precision
+// distances past ~1e19 overflow the float and come out as no attraction
+
+__attribute__((target("sse2")))
+static void sumAttractionSSE2(const double* x, const double* y, const double* mass, size_t count, double px, double py, double& ax, double& ay) {
+	__m128d vpx = _mm_set1_pd(px), vpy = _mm_set1_pd(py), half = _mm_set1_pd(0.5), threeHalves = _mm_set1_pd(1.5), zero = _mm_setzero_pd();
+	__m128d sumx = zero, sumy = zero;
+	size_t i = 0;
+	for (; i + 2 <= count; i += 2) {
+		__m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), vpx), dy = _mm_sub_pd(_mm_loadu_pd(y + i), vpy);
+		__m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+		__m128d inv = _mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(d2)));
+		__m128d halfd2 = _mm_mul_pd(half, d2);
+		inv = _mm_mul_pd(inv, _mm_sub_pd(threeHalves, _mm_mul_pd(halfd2, _mm_mul_pd(inv, inv))));
+		inv = _mm_mul_pd(inv, _mm_sub_pd(threeHalves, _mm_mul_pd(halfd2, _mm_mul_pd(inv, inv))));
+		__m128d factor = _mm_mul_pd(_mm_loadu_pd(mass + i), _mm_mul_pd(inv, _mm_mul_pd(inv, inv)));
+		factor = _mm_and_pd(factor, _mm_cmpgt_pd(d2, zero));
+		sumx = _mm_add_pd(sumx, _mm_mul_pd(dx, factor));
+		sumy = _mm_add_pd(sumy, _mm_mul_pd(dy, factor));
+	}
+	double outx[2], outy[2];
+	_mm_storeu_pd(outx, sumx);
+	_mm_storeu_pd(outy, sumy);
+	ax += outx[0] + outx[1];
+	ay += outy[0] + outy[1];
+	sumAttractionScalar(x + i, y + i, mass + i, count - i, px, py, ax, ay);
+}
+
+__attribute__((target("avx2,fma")))
+static void sumAttractionAVX2(const double* x, const double* y, const double* mass, size_t count, double px, double py, double& ax, double& ay) {
+	__m256d vpx = _mm256_set1_pd(px), vpy = _mm256_set1_pd(py), half = _mm256_set1_pd(0.5), threeHalves = _mm256_set1_pd(1.5), zero = _mm256_setzero_pd();
+	__m256d sumx = zero, sumy = zero;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), vpx), dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), vpy);
+		__m256d d2 = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+		__m256d inv = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(d2)));
+		__m256d halfd2 = _mm256_mul_pd(half, d2);
+		inv = _mm256_mul_pd(inv, _mm256_fnmadd_pd(halfd2, _mm256_mul_pd(inv, inv), threeHalves));
+		inv = _mm256_mul_pd(inv, _mm256_fnmadd_pd(halfd2, _mm256_mul_pd(inv, inv), threeHalves));
+		__m256d factor = _mm256_mul_pd(_mm256_loadu_pd(mass + i), _mm256_mul_pd(inv, _mm256_mul_pd(inv, inv)));
+		factor = _mm256_and_pd(factor, _mm256_cmp_pd(d2, zero, _CMP_GT_OQ));
+		sumx = _mm256_fmadd_pd(dx, factor, sumx);
+		sumy = _mm256_fmadd_pd(dy, factor, sumy);
+	}
+	double outx[4], outy[4];
+	_mm256_storeu_pd(outx, sumx);
+	_mm256_storeu_pd(outy, sumy);
+	ax += (outx[0] + outx[1]) + (outx[2] + outx[3]);
+	ay += (outy[0] + outy[1]) + (outy[2] + outy[3]);
+	sumAttractionScalar(x + i, y + i, mass + i, count - i, px, py, ax, ay);
+}
+#endif
+
+void sumQuadrupoles(const double* x, const double* y, const double* qxx, const double* qxy, const double* qyy, size_t count, double px, double py, double& ax, double& ay) {
+	double sumx = 0.0, sumy = 0.0;
+	for (size_t i = 0; i < count; i++) {
+		// gradient of Q(d, d) / 2r^5 with d pointing from the body to the mass
+		double dx = x[i] - px, dy = y[i] - py;
+		double inv2 = 1.0 / (dx * dx + dy * dy);
+		double inv5 = inv2 * inv2 * std::sqrt(inv2);
+		double qdx = qxx[i] * dx + qxy[i] * dy, qdy = qxy[i] * dx + qyy[i] * dy;
+		double radial = 2.5 * (dx * qdx + dy * qdy) * inv2;
+		sumx += (radial * dx - qdx) * inv5;
+		sumy += (radial * dy - qdy) * inv5;
+	}
+	ax += sumx;
+	ay += sumy;
+}
+
+using attractionKernel = void (*)(const double*, const double*, const double*, size_t, double, double, double&, double&);
+
+static attractionKernel pickKernel() {
+	attractionKernel kernel = sumAttractionScalar;
+	const char* name = "scalar";
+#ifdef OBF_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		kernel = sumAttractionAVX2;
+		name = "avx2";
+	} else if (__builtin_cpu_supports("sse2")) {
+		kernel = sumAttractionSSE2;
+		name = "sse2";
+	}
+#endif
+	if (debug) [[unlikely]] {
+		printf("Using %s gravity kernel\n", name);
+	}
+	return kernel;
+}
+
+void sumAttraction(const double* x, const double* y, const double* mass, size_t count, double px, double py, double& ax, double& ay) {
+	// function-local static so the pick happens once even with several update threads
+	static attractionKernel kernel = pickKernel();
+	kernel(x, y, mass, count, px, py, ax, ay);
+}
+
+}
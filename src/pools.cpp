@@ -0,0 +1,29 @@
+#include "entities.hpp"
+#include "globals.hpp"
+#include "pools.hpp"
+#include "strings.hpp"
+
+#include <cstdio>
+
+namespace obf {
+
+template <typename T>
+static void printPool(const char* name) {
+	char out[128];
+	snprintf(out, sizeof(out), "%s: %lu live, %lu chunks allocated, %lu reused", name, (unsigned long)EntityPool<T>::live, (unsigned long)EntityPool<T>::chunks, (unsigned long)EntityPool<T>::reused);
+	printPreferred(out);
+	EntityPool<T>::chunks = 0;
+	EntityPool<T>::reused = 0;
+}
+
+void printPoolStats() {
+	printPool<Triangle>("triangles");
+	printPool<CelestialBody>("celestial bodies");
+	printPool<Projectile>("projectiles");
+	char out[128];
+	snprintf(out, sizeof(out), "trajectories: %lu spare, %lu reused", (unsigned long)spareTrajectories.size(), (unsigned long)trajectoriesReused);
+	printPreferred(out);
+	trajectoriesReused = 0;
+}
+
+}
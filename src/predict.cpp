@@ -0,0 +1,896 @@
+#include "entities.hpp"
+#include "globals.hpp"
+#include "math.hpp"
+#include "physics.hpp"
+#include "predict.hpp"
+#include "strings.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <limits>
+#include <vector>
+
+namespace obf {
+
+constexpr uint32_t noBody = std::numeric_limits<uint32_t>::max();
+
+// Dormand–Prince 5(4), the 5th order result is kept and its difference to the 4th order one is the error estimate
+constexpr double dopriC[7] = {0.0, 1.0 / 5.0, 3.0 / 10.0, 4.0 / 5.0, 8.0 / 9.0, 1.0, 1.0};
+constexpr double dopriA[7][6] = {
+	{},
+	{1.0 / 5.0},
+	{3.0 / 40.0, 9.0 / 40.0},
+	{44.0 / 45.0, -56.0 / 15.0, 32.0 / 9.0},
+	{19372.0 / 6561.0, -25360.0 / 2187.0, 64448.0 / 6561.0, -212.0 / 729.0},
+	{9017.0 / 3168.0, -355.0 / 33.0, 46732.0 / 5247.0, 49.0 / 176.0, -5103.0 / 18656.0},
+	{35.0 / 384.0, 0.0, 500.0 / 1113.0, 125.0 / 192.0, -2187.0 / 6784.0, 11.0 / 84.0}};
+constexpr double dopriE[7] = {71.0 / 57600.0, 0.0, -71.0 / 16695.0, 71.0 / 1920.0, -17253.0 / 339200.0, 22.0 / 525.0, -1.0 / 40.0};
+// weights of the 4th order dense output
+constexpr double dopriD[7] = {-12715105075.0 / 11282082432.0, 0.0, 87487479700.0 / 32700410799.0, -10690763975.0 / 1880347072.0, 701980252875.0 / 199316789632.0, -1453857185.0 / 822651844.0, 69997945.0 / 29380423.0};
+// adaptive steps don't go below this fraction of predictDelta, so a body skimming another can't stall the worker
+constexpr double minStep = 1e-4;
+
+// what Triangle::control needs of the own ship, stepped the same way minus shooting
+struct ShipState {
+	double rotation, rotateVel, boostProgress, hyperboostCharge,
+	accel, rotateSlowSpeedMult, rotateSpeed, boostCooldown, boostStrength, hyperboostStrength, hyperboostTime, hyperboostRotateSpeed, afterburnStrength, minAfterburn;
+	bool burning;
+};
+
+// a light body, pulled by the ephemeris but pulling nothing itself
+struct Particle {
+	double x, y, velX, velY, mass, radius, accX = 0.0, accY = 0.0, step = 0.0;
+	// conics are drawn around the reference instead of being stepped
+	bool steered, ended = false, conic = false;
+};
+
+// stages of a Dormand–Prince step over some bodies, velocities and pulls at the start go in k*[0] and the ones at the end come out in k*[6]
+struct Stages {
+	std::vector<double> kx[7], ky[7], kvx[7], kvy[7], x, y, velX, velY;
+
+	void resize(size_t n) {
+		for (int i = 0; i < 7; i++) {
+			kx[i].resize(n), ky[i].resize(n), kvx[i].resize(n), kvy[i].resize(n);
+		}
+		x.resize(n), y.resize(n), velX.resize(n), velY.resize(n);
+	}
+	// the end of an accepted step is the start of the next
+	void carry() {
+		std::swap(kx[0], kx[6]), std::swap(ky[0], ky[6]), std::swap(kvx[0], kvx[6]), std::swap(kvy[0], kvy[6]);
+	}
+};
+
+// everything the worker touches, copied out of the game when it starts so neither has to wait on the other
+// massive bodies pull each other and are stepped together once into an ephemeris, light ones are stepped alone against it
+struct Prediction {
+	std::vector<double> x, y, velX, velY, accX, accY, mass, radius;
+	// positions, velocities and masses of the massive bodies at every step, masses are 0 once they've ended
+	std::vector<double> ephX, ephY, ephVelX, ephVelY, ephMass;
+	std::vector<uint32_t> ids, stars;
+	std::vector<uint8_t> ended, star;
+	std::vector<Particle> particles;
+	// the massive bodies at some time between two steps of the ephemeris
+	std::vector<double> atX, atY, atVelX, atVelY, atMass;
+	Stages massiveStages, particleStages;
+	// absolute positions of the massive bodies and then the particles, kept so the next prediction can carry on from them
+	std::vector<std::vector<Point>> paths;
+	// the same relative to the reference, handed to the entities
+	std::vector<std::vector<Point>> trajectories;
+	std::vector<Point> refPath;
+	uint32_t ref = noBody, ghost = noBody;
+	ShipState steer;
+	movement controls;
+	// startTime and fullTime are simTime, so the window moves with the ticks actually run whatever the timescale
+	double delta = 0.0, G = 0.0, startTime = 0.0, fullTime = 0.0, accuracy = 0.0, massiveStep = 0.0;
+	double conicThreshold = 0.0;
+	uint64_t massiveSteps = 0, particleSteps = 0, rejectedSteps = 0, conics = 0;
+	// steps before this are still good from the last prediction, 0 predicts all of them
+	int steps = 0, from = 0;
+	bool reduced = false, adaptive = false, valid = false;
+	EntityRef trajectoryRef;
+	sf::Color ghostColor;
+};
+
+static Prediction prediction;
+static std::future<void> worker;
+static bool running = false;
+static std::vector<Entity*> light;
+static uint64_t predictions = 0, fullPredictions = 0, massiveSteps = 0, particleSteps = 0, rejectedSteps = 0, predictedParticles = 0, conics = 0;
+
+// the velocity Triangle::control would add this step
+static void steerShip(ShipState& s, movement& cont, double delta, double& dvx, double& dvy) {
+	float rotationRad = s.rotation * degToRad;
+	double xMul = std::cos(rotationRad), yMul = -std::sin(rotationRad);
+	dvx = 0.0, dvy = 0.0;
+	s.boostProgress += delta;
+	if (cont.hyperboost || s.burning) {
+		s.hyperboostCharge += delta * (s.burning ? -2 : 1);
+		s.hyperboostCharge = std::min(s.hyperboostCharge, 2.0 * s.hyperboostTime);
+		s.burning = s.hyperboostCharge > s.hyperboostTime && (s.burning || (cont.boost && s.hyperboostCharge > s.minAfterburn));
+		if (s.burning) {
+			dvx = s.afterburnStrength * xMul * delta, dvy = s.afterburnStrength * yMul * delta;
+			return;
+		}
+		if (cont.turnleft) {
+			s.rotateVel += s.hyperboostRotateSpeed * delta;
+		} else if (cont.turnright) {
+			s.rotateVel -= s.hyperboostRotateSpeed * delta;
+		}
+		if (s.rotateVel > 0.0) {
+			s.rotateVel = std::max(0.0, s.rotateVel - s.hyperboostRotateSpeed * delta * s.rotateSlowSpeedMult);
+		}
+		if (s.rotateVel < 0.0) {
+			s.rotateVel = std::min(0.0, s.rotateVel + s.hyperboostRotateSpeed * delta * s.rotateSlowSpeedMult);
+		}
+		if (s.hyperboostCharge > s.hyperboostTime) {
+			dvx = s.hyperboostStrength * xMul * delta, dvy = s.hyperboostStrength * yMul * delta;
+		}
+		return;
+	}
+	s.hyperboostCharge = 0.0;
+	if (cont.forward) {
+		dvx = s.accel * xMul * delta, dvy = s.accel * yMul * delta;
+	} else if (cont.backward) {
+		dvx = -s.accel * xMul * delta, dvy = -s.accel * yMul * delta;
+	}
+	if (cont.turnleft) {
+		s.rotateVel += s.rotateSpeed * delta;
+	} else if (cont.turnright) {
+		s.rotateVel -= s.rotateSpeed * delta;
+	}
+	if (s.rotateVel > 0.0) {
+		s.rotateVel = std::max(0.0, s.rotateVel - s.rotateSpeed * delta * s.rotateSlowSpeedMult);
+	} else {
+		s.rotateVel = std::min(0.0, s.rotateVel + s.rotateSpeed * delta * s.rotateSlowSpeedMult);
+	}
+	if (cont.boost && s.boostProgress > s.boostCooldown) {
+		dvx += s.boostStrength * xMul, dvy += s.boostStrength * yMul;
+		s.boostProgress = 0.0;
+	}
+}
+
+// pull of the massive bodies on each other
+static void attract(Prediction& p) {
+	size_t count = p.x.size();
+	for (size_t i = 0; i < count; i++) {
+		if (p.ended[i]) {
+			continue;
+		}
+		double ax = 0.0, ay = 0.0;
+		sumAttraction(p.x.data(), p.y.data(), p.mass.data(), count, p.x[i], p.y[i], ax, ay);
+		p.accX[i] = ax * p.G;
+		p.accY[i] = ay * p.G;
+	}
+}
+
+// a lighter massive body touching another merges into it and ends, says if any did
+static bool mergeBodies(Prediction& p) {
+	size_t count = p.x.size();
+	bool merged = false;
+	for (size_t s = 0; s < count; s++) {
+		for (size_t i = 0; i < count; i++) {
+			if (i == s || p.ended[i] || p.ended[s] || p.mass[i] > p.mass[s]) {
+				continue;
+			}
+			double xdiff = p.x[i] - p.x[s], ydiff = p.y[i] - p.y[s], reach = p.radius[i] + p.radius[s];
+			if (xdiff * xdiff + ydiff * ydiff >= reach * reach) {
+				continue;
+			}
+			double total = p.mass[i] + p.mass[s];
+			p.velX[s] = (p.velX[s] * p.mass[s] + p.velX[i] * p.mass[i]) / total;
+			p.velY[s] = (p.velY[s] * p.mass[s] + p.velY[i] * p.mass[i]) / total;
+			p.mass[s] = total;
+			// ended bodies stay where they are with no mass so they pull nothing
+			p.mass[i] = 0.0;
+			p.ended[i] = true;
+			merged = true;
+		}
+	}
+	return merged;
+}
+
+static void recordEphemeris(Prediction& p, int step) {
+	size_t count = p.x.size(), at = step * count;
+	std::copy(p.x.begin(), p.x.end(), p.ephX.begin() + at);
+	std::copy(p.y.begin(), p.y.end(), p.ephY.begin() + at);
+	std::copy(p.velX.begin(), p.velX.end(), p.ephVelX.begin() + at);
+	std::copy(p.velY.begin(), p.velY.end(), p.ephVelY.begin() + at);
+	std::copy(p.mass.begin(), p.mass.end(), p.ephMass.begin() + at);
+}
+
+// leapfrog of the massive bodies, only they pull so they can go first with no regard for anything light
+static void predictMassive(Prediction& p) {
+	size_t count = p.x.size();
+	double half = p.delta * 0.5;
+	if (p.from == 0) {
+		recordEphemeris(p, 0);
+		attract(p);
+	}
+	for (int step = p.from; step < p.steps; step++) {
+		for (size_t i = 0; i < count; i++) {
+			if (p.ended[i]) {
+				continue;
+			}
+			p.velX[i] += p.accX[i] * half;
+			p.velY[i] += p.accY[i] * half;
+			p.x[i] += p.velX[i] * p.delta;
+			p.y[i] += p.velY[i] * p.delta;
+		}
+		mergeBodies(p);
+		attract(p);
+		p.massiveSteps++;
+		for (size_t i = 0; i < count; i++) {
+			if (p.ended[i]) {
+				continue;
+			}
+			p.velX[i] += p.accX[i] * half;
+			p.velY[i] += p.accY[i] * half;
+			p.paths[i].push_back({p.x[i], p.y[i]});
+		}
+		recordEphemeris(p, step + 1);
+	}
+}
+
+// pull of the massive bodies at x, y and with masses mass on a point
+static void pullOn(const Prediction& p, const double* x, const double* y, const double* mass, double px, double py, double& ax, double& ay) {
+	ax = 0.0, ay = 0.0;
+	sumAttraction(x, y, mass, p.x.size(), px, py, ax, ay);
+	ax *= p.G;
+	ay *= p.G;
+}
+
+// pull of the ephemeris at a step on a point
+static void ephemerisPull(const Prediction& p, int step, double x, double y, double& ax, double& ay) {
+	size_t at = step * p.x.size();
+	pullOn(p, p.ephX.data() + at, p.ephY.data() + at, p.ephMass.data() + at, x, y, ax, ay);
+}
+
+// a particle touching a massive body lands on it and rides along, or burns up if it's a star, which gives true
+static bool touchBodies(const Prediction& p, const double* x, const double* y, const double* velX, const double* velY, const double* mass, Particle& b, bool& landed) {
+	for (size_t s = 0; s < p.x.size(); s++) {
+		if (mass[s] == 0.0 || b.mass > mass[s]) {
+			continue;
+		}
+		double xdiff = b.x - x[s], ydiff = b.y - y[s], reach = b.radius + p.radius[s];
+		double dist2 = xdiff * xdiff + ydiff * ydiff;
+		if (dist2 >= reach * reach || dist2 == 0.0) {
+			continue;
+		}
+		if (p.star[s]) {
+			return true;
+		}
+		double dist = std::sqrt(dist2);
+		b.x = x[s] + xdiff * reach / dist;
+		b.y = y[s] + ydiff * reach / dist;
+		b.velX = velX[s];
+		b.velY = velY[s];
+		landed = true;
+	}
+	return false;
+}
+
+static bool touchEphemeris(const Prediction& p, int step, Particle& b) {
+	size_t at = step * p.x.size();
+	bool landed = false;
+	return touchBodies(p, p.ephX.data() + at, p.ephY.data() + at, p.ephVelX.data() + at, p.ephVelY.data() + at, p.ephMass.data() + at, b, landed);
+}
+
+// leapfrog of the particles against the ephemeris, the same order of moving, recording and steering as a tick
+// all of them go a step at a time so each step of the ephemeris is only read from memory once
+static void predictParticles(Prediction& p) {
+	size_t count = p.x.size();
+	double half = p.delta * 0.5;
+	ShipState steer = p.steer;
+	if (p.from == 0) {
+		for (Particle& b : p.particles) {
+			ephemerisPull(p, 0, b.x, b.y, b.accX, b.accY);
+		}
+	}
+	for (int step = p.from; step < p.steps; step++) {
+		for (size_t i = 0; i < p.particles.size(); i++) {
+			Particle& b = p.particles[i];
+			if (b.ended || b.conic) {
+				continue;
+			}
+			b.velX += b.accX * half;
+			b.velY += b.accY * half;
+			b.x += b.velX * p.delta;
+			b.y += b.velY * p.delta;
+			p.particleSteps++;
+			if (touchEphemeris(p, step + 1, b)) {
+				b.ended = true;
+				continue;
+			}
+			ephemerisPull(p, step + 1, b.x, b.y, b.accX, b.accY);
+			b.velX += b.accX * half;
+			b.velY += b.accY * half;
+			p.paths[count + i].push_back({b.x, b.y});
+			if (b.steered) {
+				steer.rotation += steer.rotateVel * p.delta;
+				double dvx, dvy;
+				steerShip(steer, p.controls, p.delta, dvx, dvy);
+				b.velX += dvx;
+				b.velY += dvy;
+			}
+		}
+	}
+}
+
+// position and velocity at a fraction s through a step of h from the ones at its ends, to read the ephemeris between its steps
+static void hermite(double s, double h, double x0, double v0, double x1, double v1, double& x, double& v) {
+	double s2 = s * s, s3 = s2 * s;
+	x = (2.0 * s3 - 3.0 * s2 + 1.0) * x0 + (s3 - 2.0 * s2 + s) * h * v0 + (3.0 * s2 - 2.0 * s3) * x1 + (s3 - s2) * h * v1;
+	v = ((6.0 * s2 - 6.0 * s) * (x0 - x1)) / h + (3.0 * s2 - 4.0 * s + 1.0) * v0 + (3.0 * s2 - 2.0 * s) * v1;
+}
+
+// a value at a fraction s through a step of h from y0 to y1, with its derivative at each stage of the step in k
+static double dopriDense(double s, double h, double y0, double y1, const std::vector<double>* k, size_t i) {
+	double r2 = y1 - y0, r3 = h * k[0][i] - r2, r4 = r2 - h * k[6][i] - r3, r5 = 0.0;
+	for (int j = 0; j < 7; j++) {
+		r5 += dopriD[j] * k[j][i];
+	}
+	r5 *= h;
+	return y0 + s * (r2 + (1.0 - s) * (r3 + s * (r4 + (1.0 - s) * r5)));
+}
+
+// one Dormand–Prince step of h from time t, pull(time, x, y, accX, accY) has to give the pull on all n bodies at some positions
+// the result goes in k.x, k.y, k.velX, k.velY, returns the largest error of any body over what accuracy lets it have
+template <typename Pull>
+static double dopriStep(Stages& k, size_t n, const double* x, const double* y, const double* velX, const double* velY, double t, double h, double accuracy, Pull pull) {
+	for (int stage = 1; stage < 7; stage++) {
+		for (size_t i = 0; i < n; i++) {
+			double sx = x[i], sy = y[i], svx = velX[i], svy = velY[i];
+			for (int j = 0; j < stage; j++) {
+				double a = dopriA[stage][j] * h;
+				sx += a * k.kx[j][i];
+				sy += a * k.ky[j][i];
+				svx += a * k.kvx[j][i];
+				svy += a * k.kvy[j][i];
+			}
+			k.x[i] = sx, k.y[i] = sy, k.velX[i] = svx, k.velY[i] = svy;
+			k.kx[stage][i] = svx;
+			k.ky[stage][i] = svy;
+		}
+		pull(t + dopriC[stage] * h, k.x.data(), k.y.data(), k.kvx[stage].data(), k.kvy[stage].data());
+	}
+	// error in position, and in velocity times the step so it's in meters too
+	double worst = 0.0;
+	for (size_t i = 0; i < n; i++) {
+		double ex = 0.0, ey = 0.0, evx = 0.0, evy = 0.0;
+		for (int j = 0; j < 7; j++) {
+			ex += dopriE[j] * k.kx[j][i];
+			ey += dopriE[j] * k.ky[j][i];
+			evx += dopriE[j] * k.kvx[j][i];
+			evy += dopriE[j] * k.kvy[j][i];
+		}
+		worst = std::max(worst, std::max(dst(ex, ey), dst(evx, evy) * h) / accuracy);
+	}
+	return worst;
+}
+
+// how much to scale a step by for the error it had to land on what's allowed, within 5 times either way
+static double stepFactor(double error) {
+	return error == 0.0 ? 5.0 : std::clamp(0.9 * std::pow(error, -0.2), 0.2, 5.0);
+}
+
+// the massive bodies at t seconds into the prediction into the at arrays
+static void ephemerisAt(Prediction& p, double t) {
+	size_t count = p.x.size();
+	double f = std::clamp(t / p.delta, 0.0, (double)p.steps);
+	int row = std::min((int)f, p.steps - 1);
+	double s = f - row;
+	size_t a = row * count, b = a + count;
+	for (size_t i = 0; i < count; i++) {
+		hermite(s, p.delta, p.ephX[a + i], p.ephVelX[a + i], p.ephX[b + i], p.ephVelX[b + i], p.atX[i], p.atVelX[i]);
+		hermite(s, p.delta, p.ephY[a + i], p.ephVelY[a + i], p.ephY[b + i], p.ephVelY[b + i], p.atY[i], p.atVelY[i]);
+		p.atMass[i] = p.ephMass[a + i];
+	}
+}
+
+// the massive bodies share a step, set by whichever of them has the largest error, and are sampled onto the ephemeris steps
+static void predictMassiveAdaptive(Prediction& p) {
+	size_t count = p.x.size();
+	Stages& k = p.massiveStages;
+	k.resize(count);
+	auto pull = [&p, count](double, const double* x, const double* y, double* ax, double* ay) {
+		for (size_t i = 0; i < count; i++) {
+			ax[i] = 0.0, ay[i] = 0.0;
+			if (!p.ended[i]) {
+				pullOn(p, x, y, p.mass.data(), x[i], y[i], ax[i], ay[i]);
+			}
+		}
+	};
+	if (p.from == 0) {
+		recordEphemeris(p, 0);
+		p.massiveStep = p.delta;
+	}
+	double t = p.from * p.delta, end = p.steps * p.delta;
+	int next = p.from + 1;
+	bool fresh = true;
+	while (next <= p.steps) {
+		if (fresh) {
+			std::copy(p.velX.begin(), p.velX.end(), k.kx[0].begin());
+			std::copy(p.velY.begin(), p.velY.end(), k.ky[0].begin());
+			pull(t, p.x.data(), p.y.data(), k.kvx[0].data(), k.kvy[0].data());
+			fresh = false;
+		}
+		double step = std::min(p.massiveStep, end - t);
+		double error = dopriStep(k, count, p.x.data(), p.y.data(), p.velX.data(), p.velY.data(), t, step, p.accuracy * step, pull);
+		if (error > 1.0 && step > p.delta * minStep) {
+			p.massiveStep = std::max(p.delta * minStep, step * stepFactor(error));
+			p.rejectedSteps++;
+			continue;
+		}
+		// a step cut short to land on the end says little about the full one, which is kept
+		if (step == p.massiveStep) {
+			p.massiveStep = std::max(p.delta * minStep, step * stepFactor(error));
+		}
+		p.massiveSteps++;
+		bool last = step == end - t;
+		for (; next <= p.steps && (last || next * p.delta <= t + step); next++) {
+			double s = std::min(1.0, (next * p.delta - t) / step);
+			size_t at = next * count;
+			for (size_t i = 0; i < count; i++) {
+				p.ephX[at + i] = dopriDense(s, step, p.x[i], k.x[i], k.kx, i);
+				p.ephY[at + i] = dopriDense(s, step, p.y[i], k.y[i], k.ky, i);
+				p.ephVelX[at + i] = dopriDense(s, step, p.velX[i], k.velX[i], k.kvx, i);
+				p.ephVelY[at + i] = dopriDense(s, step, p.velY[i], k.velY[i], k.kvy, i);
+				p.ephMass[at + i] = p.mass[i];
+				if (!p.ended[i]) {
+					p.paths[i].push_back({p.ephX[at + i], p.ephY[at + i]});
+				}
+			}
+		}
+		std::copy(k.x.begin(), k.x.end(), p.x.begin());
+		std::copy(k.y.begin(), k.y.end(), p.y.begin());
+		std::copy(k.velX.begin(), k.velX.end(), p.velX.begin());
+		std::copy(k.velY.begin(), k.velY.end(), p.velY.begin());
+		t = last ? end : t + step;
+		k.carry();
+		fresh = mergeBodies(p);
+	}
+}
+
+// every particle with its own step against the ephemeris, a steered one stops on every step of it to be steered
+static void predictParticlesAdaptive(Prediction& p) {
+	size_t count = p.x.size();
+	Stages& k = p.particleStages;
+	k.resize(1);
+	p.atX.resize(count), p.atY.resize(count), p.atVelX.resize(count), p.atVelY.resize(count), p.atMass.resize(count);
+	auto pull = [&p](double t, const double* x, const double* y, double* ax, double* ay) {
+		ephemerisAt(p, t);
+		pullOn(p, p.atX.data(), p.atY.data(), p.atMass.data(), x[0], y[0], ax[0], ay[0]);
+	};
+	ShipState steer = p.steer;
+	double end = p.steps * p.delta;
+	for (size_t i = 0; i < p.particles.size(); i++) {
+		Particle& b = p.particles[i];
+		std::vector<Point>& path = p.paths[count + i];
+		if (p.from == 0) {
+			b.step = p.delta;
+		}
+		double t = p.from * p.delta;
+		int next = p.from + 1;
+		bool fresh = true;
+		while (!b.ended && !b.conic && next <= p.steps) {
+			if (fresh) {
+				k.kx[0][0] = b.velX;
+				k.ky[0][0] = b.velY;
+				pull(t, &b.x, &b.y, &k.kvx[0][0], &k.kvy[0][0]);
+				fresh = false;
+			}
+			double until = b.steered ? next * p.delta : end;
+			double step = std::min(b.step, until - t);
+			double error = dopriStep(k, 1, &b.x, &b.y, &b.velX, &b.velY, t, step, p.accuracy * step, pull);
+			if (error > 1.0 && step > p.delta * minStep) {
+				b.step = std::max(p.delta * minStep, step * stepFactor(error));
+				p.rejectedSteps++;
+				continue;
+			}
+			if (step == b.step) {
+				b.step = std::max(p.delta * minStep, step * stepFactor(error));
+			}
+			p.particleSteps++;
+			bool last = step == until - t;
+			for (; next <= p.steps && (last || (!b.steered && next * p.delta <= t + step)); next++) {
+				double s = std::min(1.0, (next * p.delta - t) / step);
+				path.push_back({dopriDense(s, step, b.x, k.x[0], k.kx, 0), dopriDense(s, step, b.y, k.y[0], k.ky, 0)});
+				if (b.steered) {
+					break;
+				}
+			}
+			b.x = k.x[0], b.y = k.y[0], b.velX = k.velX[0], b.velY = k.velY[0];
+			t = last ? until : t + step;
+			k.carry();
+			ephemerisAt(p, t);
+			bool landed = false;
+			b.ended = touchBodies(p, p.atX.data(), p.atY.data(), p.atVelX.data(), p.atVelY.data(), p.atMass.data(), b, landed);
+			fresh = landed;
+			if (b.steered && last) {
+				next++;
+				steer.rotation += steer.rotateVel * p.delta;
+				double dvx, dvy;
+				steerShip(steer, p.controls, p.delta, dvx, dvy);
+				b.velX += dvx;
+				b.velY += dvy;
+				fresh = true;
+			}
+		}
+	}
+}
+
+// Stumpff functions c(z) and s(z) of the universal variable formulation
+static void stumpff(double z, double& c, double& s) {
+	if (z > 1e-6) {
+		double root = std::sqrt(z);
+		c = (1.0 - std::cos(root)) / z;
+		s = (root - std::sin(root)) / (z * root);
+	} else if (z < -1e-6) {
+		double root = std::sqrt(-z);
+		c = (std::cosh(root) - 1.0) / -z;
+		s = (std::sinh(root) - root) / (-z * root);
+	} else {
+		c = 0.5 - z / 24.0;
+		s = 1.0 / 6.0 - z / 120.0;
+	}
+}
+
+// a body at x, y going at velX, velY relative to one with mu = G * mass after time t along the conic they're on
+// works the same for ellipses, parabolas and hyperbolas, chi carries the universal anomaly over to the next call as a guess
+static void kepler(double mu, double x, double y, double velX, double velY, double t, double& chi, double& outX, double& outY, double& outVelX, double& outVelY) {
+	double r0 = dst(x, y), radialVel = (x * velX + y * velY) / r0, rootMu = std::sqrt(mu);
+	// reciprocal of the semi-major axis, positive for ellipses
+	double alpha = 2.0 / r0 - (velX * velX + velY * velY) / mu;
+	if (alpha > 0.0) {
+		double period = 2.0 * PI / (rootMu * alpha * std::sqrt(alpha));
+		t = std::fmod(t, period);
+		chi = std::fmod(chi, 2.0 * PI / std::sqrt(alpha));
+	}
+	if (chi == 0.0) {
+		chi = rootMu * std::abs(alpha) * t;
+	}
+	double c, s, z;
+	for (int i = 0; i < 50; i++) {
+		z = alpha * chi * chi;
+		stumpff(z, c, s);
+		double f = r0 * radialVel / rootMu * chi * chi * c + (1.0 - alpha * r0) * chi * chi * chi * s + r0 * chi - rootMu * t;
+		double df = r0 * radialVel / rootMu * chi * (1.0 - z * s) + (1.0 - alpha * r0) * chi * chi * c + r0;
+		double change = f / df;
+		chi -= change;
+		if (std::abs(change) < 1e-12 * std::max(1.0, std::abs(chi))) {
+			break;
+		}
+	}
+	z = alpha * chi * chi;
+	stumpff(z, c, s);
+	double f = 1.0 - chi * chi / r0 * c, g = t - chi * chi * chi / rootMu * s;
+	outX = f * x + g * velX;
+	outY = f * y + g * velY;
+	double r = dst(outX, outY);
+	double df = rootMu / (r * r0) * (z * chi * s - chi), dg = 1.0 - chi * chi / r * c;
+	outVelX = df * x + dg * velX;
+	outVelY = df * y + dg * velY;
+}
+
+// light bodies that would stay on a conic around the reference, for which the differential pull of everything else along it
+// is within conicThreshold of the reference's own and which don't come close enough to hit it
+static void fitConics(Prediction& p) {
+	size_t count = p.x.size(), last = p.steps * count;
+	if (p.conicThreshold <= 0.0 || p.ref >= count || p.ephMass[last + p.ref] == 0.0) {
+		return;
+	}
+	double mu = p.G * p.ephMass[p.ref];
+	for (Particle& b : p.particles) {
+		if (b.steered || b.ended) {
+			continue;
+		}
+		double x = b.x - p.ephX[p.ref], y = b.y - p.ephY[p.ref], velX = b.velX - p.ephVelX[p.ref], velY = b.velY - p.ephVelY[p.ref];
+		// periapsis from the eccentricity vector
+		double r = dst(x, y), radial = x * velX + y * velY, speed2 = velX * velX + velY * velY;
+		double ex = ((speed2 - mu / r) * x - radial * velX) / mu, ey = ((speed2 - mu / r) * y - radial * velY) / mu;
+		double momentum = x * velY - y * velX;
+		if (momentum * momentum / mu / (1.0 + dst(ex, ey)) < b.radius + p.radius[p.ref]) {
+			continue;
+		}
+		bool fits = true;
+		double chi = 0.0;
+		// every 16th step is plenty for how slowly the pull of others changes
+		for (int step = 0; step <= p.steps && fits; step += 16) {
+			double px, py, pvx, pvy;
+			kepler(mu, x, y, velX, velY, step * p.delta, chi, px, py, pvx, pvy);
+			size_t at = step * count;
+			double refX = p.ephX[at + p.ref], refY = p.ephY[at + p.ref];
+			double ax = 0.0, ay = 0.0, rx = 0.0, ry = 0.0;
+			sumAttraction(p.ephX.data() + at, p.ephY.data() + at, p.ephMass.data() + at, count, refX + px, refY + py, ax, ay);
+			sumAttraction(p.ephX.data() + at, p.ephY.data() + at, p.ephMass.data() + at, count, refX, refY, rx, ry);
+			// what's left once the reference's pull on the body is taken off and the pull on the reference is too
+			double rp = dst(px, py), own = p.ephMass[at + p.ref] / (rp * rp * rp);
+			double tidalX = ax + px * own - rx, tidalY = ay + py * own - ry;
+			fits = dst(tidalX, tidalY) < p.conicThreshold * p.ephMass[at + p.ref] / (rp * rp);
+		}
+		b.conic = fits;
+	}
+}
+
+// paths of the conic bodies, from where each is relative to the reference at the start of what's predicted
+static void predictConics(Prediction& p) {
+	size_t count = p.x.size();
+	// only a massive reference can have conics around it, the system center and light ones have none
+	if (p.ref >= count) {
+		return;
+	}
+	size_t at = p.from * count + p.ref, end = p.steps * count + p.ref;
+	double mu = p.G * p.ephMass[at];
+	for (size_t i = 0; i < p.particles.size(); i++) {
+		Particle& b = p.particles[i];
+		if (!b.conic) {
+			continue;
+		}
+		p.conics++;
+		double x = b.x - p.ephX[at], y = b.y - p.ephY[at], velX = b.velX - p.ephVelX[at], velY = b.velY - p.ephVelY[at];
+		double chi = 0.0, px = x, py = y, pvx = velX, pvy = velY;
+		for (int step = p.from + 1; step <= p.steps; step++) {
+			kepler(mu, x, y, velX, velY, (step - p.from) * p.delta, chi, px, py, pvx, pvy);
+			size_t row = step * count + p.ref;
+			p.paths[count + i].push_back({p.ephX[row] + px, p.ephY[row] + py});
+		}
+		b.x = p.ephX[end] + px, b.y = p.ephY[end] + py;
+		b.velX = p.ephVelX[end] + pvx, b.velY = p.ephVelY[end] + pvy;
+	}
+}
+
+// drops what's now in the past off the front of the ephemeris and the paths
+static void slideWindow(Prediction& p) {
+	size_t count = p.x.size(), shift = p.steps - p.from;
+	for (std::vector<double>* eph : {&p.ephX, &p.ephY, &p.ephVelX, &p.ephVelY, &p.ephMass}) {
+		std::copy(eph->begin() + shift * count, eph->end(), eph->begin());
+	}
+	for (std::vector<Point>& path : p.paths) {
+		path.erase(path.begin(), path.begin() + std::min(shift, path.size()));
+	}
+}
+
+static void predict(Prediction& p) {
+	if (p.from > 0) {
+		slideWindow(p);
+	}
+	p.massiveSteps = 0, p.particleSteps = 0, p.rejectedSteps = 0, p.conics = 0;
+	if (p.adaptive) {
+		predictMassiveAdaptive(p);
+	} else {
+		predictMassive(p);
+	}
+	if (p.from == 0) {
+		fitConics(p);
+	}
+	if (p.adaptive) {
+		predictParticlesAdaptive(p);
+	} else {
+		predictParticles(p);
+	}
+	predictConics(p);
+	size_t count = p.x.size();
+	// the reference stays where it ended, the system center sits between the stars
+	p.refPath.assign(p.steps, {0.0, 0.0});
+	for (int step = 0; step < p.steps; step++) {
+		Point& point = p.refPath[step];
+		if (p.ref != noBody && !p.paths[p.ref].empty()) {
+			std::vector<Point>& path = p.paths[p.ref];
+			point = path[std::min((size_t)step, path.size() - 1)];
+		} else if (p.ref == noBody && !p.stars.empty()) {
+			size_t at = (step + 1) * count;
+			for (uint32_t star : p.stars) {
+				point.x += p.ephX[at + star] / p.stars.size();
+				point.y += p.ephY[at + star] / p.stars.size();
+			}
+		}
+	}
+	for (size_t i = 0; i < p.paths.size(); i++) {
+		std::vector<Point>& path = p.paths[i];
+		std::vector<Point>& traj = p.trajectories[i];
+		traj.resize(path.size());
+		for (size_t j = 0; j < path.size(); j++) {
+			traj[j] = {path[j].x - p.refPath[j].x, path[j].y - p.refPath[j].y};
+		}
+	}
+}
+
+// bodies pulling everything else, the own ship is always light so it and its ghost, which start in the same spot, can't pull each other
+static bool massiveBody(Entity* e, double testMass) {
+	return e->mass() >= testMass && e != ownEntity && (e->type() == Entities::CelestialBody || !reducedPrediction);
+}
+
+// only the orbit lines of the own ship and of what they're drawn around matter in the reduced model
+static bool lightBody(Entity* e) {
+	return !reducedPrediction || e == ownEntity || e == trajectoryRef;
+}
+
+// whether the last prediction can be carried on by the steps since it started instead of being done again
+// it can't if what it predicted no longer matches, bodies were merged or made or corrected by more than predictTolerance
+static bool canSlide(Prediction& p, double testMass, int ahead) {
+	if (!p.valid || p.ghost != noBody || *(unsigned char*) &controls != 0 || p.trajectoryRef.get() != trajectoryRef.get()
+	|| p.delta != predictDelta || p.steps != predictSteps || p.reduced != reducedPrediction
+	|| p.adaptive != (predictIntegrator == "adaptive") || p.accuracy != predictAccuracy || p.conicThreshold != conicThreshold
+	|| ahead < 1 || ahead >= p.steps || simTime - p.fullTime > predictRefresh) {
+		return false;
+	}
+	size_t predicted = 0;
+	for (Entity* e : updateGroup) {
+		predicted += massiveBody(e, testMass) || lightBody(e);
+	}
+	if (predicted != p.ids.size()) {
+		return false;
+	}
+	// where each body should be now, between the points at the steps either side
+	double fraction = (simTime - p.startTime) / p.delta - ahead;
+	for (size_t i = 0; i < p.ids.size(); i++) {
+		Entity* e = idLookup(p.ids[i]);
+		std::vector<Point>& path = p.paths[i];
+		if (!e || path.size() <= (size_t)ahead) {
+			return false;
+		}
+		Point from = path[ahead - 1], to = path[ahead];
+		double x = from.x + (to.x - from.x) * fraction, y = from.y + (to.y - from.y) * fraction;
+		if (dst2(e->x() - x, e->y() - y) > predictTolerance * predictTolerance) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void startPrediction() {
+	if (running) {
+		return;
+	}
+	// a reference that isn't simulated, other than the system center, has nothing to predict against, the last trajectories are kept
+	if (trajectoryRef != systemCenter && std::find(updateGroup.begin(), updateGroup.end(), trajectoryRef.get()) == updateGroup.end()) [[unlikely]] {
+		return;
+	}
+	Prediction& p = prediction;
+	double maxMass = 0.0;
+	for (Entity* e : updateGroup) {
+		maxMass = std::max(maxMass, e->mass());
+	}
+	double testMass = maxMass * testParticleMassRatio;
+	int ahead = p.valid ? (simTime - p.startTime) / p.delta : 0;
+	if (canSlide(p, testMass, ahead)) {
+		p.from = p.steps - ahead;
+		p.startTime += ahead * p.delta;
+		lastPredict = globalTime;
+		running = true;
+		worker = std::async(std::launch::async, predict, std::ref(p));
+		return;
+	}
+	p.valid = false;
+	p.from = 0;
+	p.x.clear(), p.y.clear(), p.velX.clear(), p.velY.clear(), p.mass.clear(), p.radius.clear();
+	p.ids.clear(), p.stars.clear(), p.star.clear(), p.particles.clear();
+	p.ref = noBody, p.ghost = noBody;
+	Triangle* ship = dynamic_cast<Triangle*>(ownEntity);
+	bool steering = ship && *(unsigned char*) &controls != 0;
+	light.clear();
+	for (Entity* e : updateGroup) {
+		if (!massiveBody(e, testMass)) {
+			if (lightBody(e)) {
+				light.push_back(e);
+			}
+			continue;
+		}
+		if (e == trajectoryRef) {
+			p.ref = p.x.size();
+		}
+		p.x.push_back(e->x());
+		p.y.push_back(e->y());
+		p.velX.push_back(e->velX());
+		p.velY.push_back(e->velY());
+		p.mass.push_back(e->mass());
+		p.radius.push_back(e->radius());
+		p.ids.push_back(e->id);
+		bool star = e->type() == Entities::CelestialBody && ((CelestialBody*)e)->star;
+		p.star.push_back(star);
+		if (star) {
+			p.stars.push_back(p.x.size() - 1);
+		}
+	}
+	for (Entity* e : light) {
+		if (e == trajectoryRef) {
+			p.ref = p.x.size() + p.particles.size();
+		}
+		p.particles.push_back({e->x(), e->y(), e->velX(), e->velY(), e->mass(), e->radius(), 0.0, 0.0, 0.0, steering && e == ownEntity});
+		p.ids.push_back(e->id);
+	}
+	p.controls = controls;
+	if (steering) {
+		// the ghost carries on with no input so both paths show
+		p.ghost = p.x.size() + p.particles.size();
+		p.particles.push_back({ship->x(), ship->y(), ship->velX(), ship->velY(), ship->mass(), ship->radius(), 0.0, 0.0, 0.0, false});
+		p.ids.push_back(noBody);
+		p.ghostColor = sf::Color(ship->color[0] * 0.7, ship->color[1] * 0.7, ship->color[2] * 0.7);
+		p.steer = {ship->rotation, ship->rotateVel, ship->boostProgress, ship->hyperboostCharge,
+		ship->accel, ship->rotateSlowSpeedMult, ship->rotateSpeed, ship->boostCooldown, ship->boostStrength, ship->hyperboostStrength, ship->hyperboostTime, ship->hyperboostRotateSpeed, ship->afterburnStrength, ship->minAfterburn,
+		ship->burning};
+	}
+	size_t count = p.x.size();
+	p.accX.assign(count, 0.0);
+	p.accY.assign(count, 0.0);
+	p.ended.assign(count, false);
+	size_t ephemerisSize = (predictSteps + 1) * count;
+	p.ephX.resize(ephemerisSize);
+	p.ephY.resize(ephemerisSize);
+	p.ephVelX.resize(ephemerisSize);
+	p.ephVelY.resize(ephemerisSize);
+	p.ephMass.resize(ephemerisSize);
+	// buffers handed back by the last collect keep their memory
+	p.trajectories.resize(p.ids.size());
+	p.paths.resize(p.ids.size());
+	for (std::vector<Point>& path : p.paths) {
+		path.clear();
+	}
+	p.delta = predictDelta;
+	p.steps = predictSteps;
+	p.G = G;
+	p.startTime = simTime;
+	p.fullTime = simTime;
+	p.reduced = reducedPrediction;
+	p.adaptive = predictIntegrator == "adaptive";
+	p.accuracy = predictAccuracy;
+	p.conicThreshold = conicThreshold;
+	p.valid = true;
+	p.trajectoryRef = trajectoryRef;
+	lastPredict = globalTime;
+	running = true;
+	worker = std::async(std::launch::async, predict, std::ref(p));
+}
+
+void collectPrediction() {
+	if (!running || worker.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+		return;
+	}
+	worker.get();
+	running = false;
+	Prediction& p = prediction;
+	predictions++;
+	fullPredictions += p.from == 0;
+	massiveSteps += p.massiveSteps;
+	particleSteps += p.particleSteps;
+	rejectedSteps += p.rejectedSteps;
+	predictedParticles += p.particles.size();
+	conics += p.conics;
+	// bodies left out of the prediction shouldn't keep showing an old one
+	for (Entity* e : updateGroup) {
+		e->trajectory.clear();
+	}
+	// swapping leaves the old trajectories with the worker to be overwritten next time
+	for (size_t i = 0; i < p.ids.size(); i++) {
+		if (p.ids[i] == noBody) {
+			continue;
+		}
+		Entity* e = idLookup(p.ids[i]);
+		if (e) {
+			e->trajectory.swap(p.trajectories[i]);
+		}
+	}
+	ghostTrajectories.resize(p.ghost == noBody ? 0 : 1);
+	ghostTrajectoryColors.resize(ghostTrajectories.size());
+	if (p.ghost != noBody) {
+		ghostTrajectories[0].swap(p.trajectories[p.ghost]);
+		ghostTrajectoryColors[0] = p.ghostColor;
+	}
+	predictedFrom = p.startTime;
+	lastTrajectoryRef = p.trajectoryRef;
+}
+
+void printPredictionStats() {
+	char out[240];
+	double runs = std::max(predictions, (uint64_t)1);
+	snprintf(out, sizeof(out), "%lu predictions, %lu from scratch, %.1f massive steps and %.1f steps per light body each, %lu steps rejected, %lu of %lu light body paths drawn as conics",
+	(unsigned long)predictions, (unsigned long)fullPredictions, massiveSteps / runs, particleSteps / (double)std::max(predictedParticles, (uint64_t)1), (unsigned long)rejectedSteps,
+	(unsigned long)conics, (unsigned long)predictedParticles);
+	printPreferred(out);
+	predictions = 0, fullPredictions = 0, massiveSteps = 0, particleSteps = 0, rejectedSteps = 0, predictedParticles = 0, conics = 0;
+}
+
+}
@@ -0,0 +1,684 @@
+#include "camera.hpp"
+#include "entities.hpp"
+#include "fmm.hpp"
+#include "globals.hpp"
+#include "math.hpp"
+#include "physics.hpp"
+#include "quadtree.hpp"
+#include "strings.hpp"
+#include "threads.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+namespace obf {
+
+static std::vector<uint64_t> mortonKeys, testKeys, sortedKeys;
+static std::vector<uint32_t> sortedBodies, levelStarts, leafQuads;
+static std::vector<uint32_t> testParticles; // BodyStore slots of bodies that are left out of the tree, in Morton order
+static std::vector<std::array<uint32_t, 2>> testGroups; // first and count of test particles that walk the tree together
+static std::vector<std::array<uint32_t, 256>> radixCounts;
+static std::vector<std::array<uint32_t, 5>> splits; // child range boundaries of the level being built
+static std::vector<std::array<double, 4>> quadBoxes; // bounding box of the bodies under each quad
+static uint64_t builtGeneration = 0; // bodies.generation at the last full build, a refit needs the same bodies
+static double builtSpan = 0.0;
+
+// moves the low 32 bits of v to the even bits
+static inline uint64_t spreadBits(uint64_t v) {
+	v &= 0xffffffff;
+	v = (v | (v << 16)) & 0x0000ffff0000ffff;
+	v = (v | (v << 8)) & 0x00ff00ff00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0f;
+	v = (v | (v << 2)) & 0x3333333333333333;
+	v = (v | (v << 1)) & 0x5555555555555555;
+	return v;
+}
+static inline uint32_t compactBits(uint64_t v) {
+	v &= 0x5555555555555555;
+	v = (v | (v >> 1)) & 0x3333333333333333;
+	v = (v | (v >> 2)) & 0x0f0f0f0f0f0f0f0f;
+	v = (v | (v >> 4)) & 0x00ff00ff00ff00ff;
+	v = (v | (v >> 8)) & 0x0000ffff0000ffff;
+	v = (v | (v >> 16)) & 0x00000000ffffffff;
+	return v;
+}
+
+// 2 bits per level, x in the low bit, so the digit is the child index
+static inline uint8_t keyDigit(uint64_t key, int level) {
+	return (key >> (62 - 2 * level)) & 3;
+}
+
+static double rootX, rootY, rootSize;
+static uint32_t smallPeak = 0; // most quads any build needed since the tree got small
+static int smallBuilds = 0;
+
+// Z-order keys of slots within the square at x, y
+static void computeKeys(const std::vector<uint32_t>& slots, std::vector<uint64_t>& keys, double x, double y, double size) {
+	const double* bx = bodies.x.data();
+	const double* by = bodies.y.data();
+	keys.resize(slots.size());
+	double scale = size > 0.0 ? 4294967296.0 / size : 0.0, maxCoord = 4294967295.0;
+	parallelFor(slots.size(), [&](size_t from, size_t to) {
+		for (size_t i = from; i < to; i++) {
+			double cx = (bx[slots[i]] - x) * scale, cy = (by[slots[i]] - y) * scale;
+			cx = cx > 0.0 ? (cx < maxCoord ? cx : maxCoord) : 0.0; // also catches NaN
+			cy = cy > 0.0 ? (cy < maxCoord ? cy : maxCoord) : 0.0;
+			keys[i] = spreadBits((uint64_t)cx) | spreadBits((uint64_t)cy) << 1;
+		}
+	});
+}
+
+// bounding square of slots as x, y, size
+static std::array<double, 3> boundsOf(const std::vector<uint32_t>& slots) {
+	double x1 = +INFINITY, y1 = +INFINITY, x2 = -INFINITY, y2 = -INFINITY;
+	for (uint32_t b : slots) {
+		x1 = std::min(bodies.x[b], x1);
+		y1 = std::min(bodies.y[b], y1);
+		x2 = std::max(bodies.x[b], x2);
+		y2 = std::max(bodies.y[b], y2);
+	}
+	return {x1, y1, std::max(x2 - x1, y2 - y1)};
+}
+
+// splits a range of sorted test particles into cells holding at most quadtreeBucketSize of them, like quadtree leaves
+static void groupTestParticles(uint32_t first, uint32_t count) {
+	uint64_t lo = testKeys[first], hi = testKeys[first + count - 1];
+	if (lo == hi || count <= (uint32_t)std::max(quadtreeBucketSize, 1)) {
+		testGroups.push_back({first, count});
+		return;
+	}
+	int level = __builtin_clzll(lo ^ hi) / 2;
+	uint32_t from = first;
+	for (int c = 1; c <= 4; c++) {
+		uint32_t to = std::lower_bound(testKeys.begin() + from, testKeys.begin() + first + count, c, [&](uint64_t key, int digit) {
+			return keyDigit(key, level) < digit;
+		}) - testKeys.begin();
+		if (to > from) {
+			groupTestParticles(from, to - from);
+		}
+		from = to;
+	}
+}
+
+// sets quad geometry to the cell at level containing key
+static void setCell(Quad& quad, uint64_t key, int level) {
+	uint64_t prefix = level == 0 ? 0 : key >> (64 - 2 * level);
+	quad.size = std::ldexp(rootSize, -level);
+	quad.invsize = 1.0 / quad.size;
+	quad.x = rootX + compactBits(prefix) * quad.size;
+	quad.y = rootY + compactBits(prefix >> 1) * quad.size;
+}
+
+// LSD radix sort of keys and body slots by key, 8 bits per pass, passes where every key has the same digit are skipped
+static void sortMorton(std::vector<uint64_t>& keys, std::vector<uint32_t>& slots) {
+	size_t count = keys.size();
+	if (count == 0) {
+		return;
+	}
+	size_t parts = parallelParts(count), partSize = (count + parts - 1) / parts;
+	radixCounts.resize(parts);
+	sortedKeys.resize(count);
+	sortedBodies.resize(count);
+	for (int shift = 0; shift < 64; shift += 8) {
+		parallelTasks(parts, [&](size_t p) {
+			std::array<uint32_t, 256>& counts = radixCounts[p];
+			counts.fill(0);
+			for (size_t i = p * partSize; i < std::min(count, (p + 1) * partSize); i++) {
+				counts[(keys[i] >> shift) & 255]++;
+			}
+		});
+		size_t firstDigit = (keys[0] >> shift) & 255, sameDigit = 0;
+		for (size_t p = 0; p < parts; p++) {
+			sameDigit += radixCounts[p][firstDigit];
+		}
+		if (sameDigit == count) {
+			continue;
+		}
+		uint32_t offset = 0;
+		for (size_t d = 0; d < 256; d++) {
+			for (size_t p = 0; p < parts; p++) {
+				uint32_t c = radixCounts[p][d];
+				radixCounts[p][d] = offset;
+				offset += c;
+			}
+		}
+		parallelTasks(parts, [&](size_t p) {
+			std::array<uint32_t, 256>& offsets = radixCounts[p];
+			for (size_t i = p * partSize; i < std::min(count, (p + 1) * partSize); i++) {
+				uint32_t to = offsets[(keys[i] >> shift) & 255]++;
+				sortedKeys[to] = keys[i];
+				sortedBodies[to] = slots[i];
+			}
+		});
+		keys.swap(sortedKeys);
+		slots.swap(sortedBodies);
+	}
+}
+
+// what a group of bodies is pulled by, quads far enough away to be treated as one and bodies to attract directly
+struct PointList {
+	std::vector<double> x, y, mass; // point masses, the quads and then the bodies once the walk is done
+	std::vector<double> qxx, qxy, qyy; // quadrupoles of the quads
+	std::vector<uint32_t> bodies;
+
+	void clear() {
+		x.clear();
+		y.clear();
+		mass.clear();
+		qxx.clear();
+		qxy.clear();
+		qyy.clear();
+		bodies.clear();
+	}
+	void addQuad(const Quad& quad) {
+		x.push_back(quad.comx);
+		y.push_back(quad.comy);
+		mass.push_back(quad.mass);
+		if (gravityQuadrupoles) {
+			qxx.push_back(quad.qxx);
+			qxy.push_back(quad.qxy);
+			qyy.push_back(quad.qyy);
+		}
+	}
+	void addBodies() {
+		for (uint32_t body : bodies) {
+			x.push_back(obf::bodies.x[body]);
+			y.push_back(obf::bodies.y[body]);
+			mass.push_back(obf::bodies.mass[body]);
+		}
+	}
+	void sum(double px, double py, double& ax, double& ay) const {
+		sumAttraction(x.data(), y.data(), mass.data(), mass.size(), px, py, ax, ay);
+		sumQuadrupoles(x.data(), y.data(), qxx.data(), qxy.data(), qyy.data(), qxx.size(), px, py, ax, ay);
+	}
+};
+
+// per thread scratch for attractGroup()
+struct InteractionList {
+	PointList near, far; // far is only filled on ticks the far field is refreshed
+	std::vector<uint32_t> stack, farStack;
+};
+static thread_local InteractionList interactions;
+static std::atomic<uint64_t> quadVisits = 0, leafWalks = 0, pulledBodies = 0, farRefreshes = 0;
+static bool refreshAllFar = false, keepFar = false; // for printFarFieldError(), keepFar only refreshes caches that are too old to use
+
+// phase spreads the far field refreshes of different groups over the ticks between them
+static void attractGroup(const uint32_t* group, uint32_t count, size_t phase) {
+	InteractionList& list = interactions;
+	const double* bx = bodies.x.data();
+	const double* by = bodies.y.data();
+	const uint8_t* due = bodies.due.data();
+	// bounding box of the group's bodies that are due, the rest keep their gravity from earlier
+	double gx1 = +INFINITY, gy1 = +INFINITY, gx2 = -INFINITY, gy2 = -INFINITY;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t b = group[i];
+		if (!due[b]) {
+			continue;
+		}
+		gx1 = std::min(gx1, bx[b]);
+		gy1 = std::min(gy1, by[b]);
+		gx2 = std::max(gx2, bx[b]);
+		gy2 = std::max(gy2, by[b]);
+	}
+	if (gx1 > gx2) {
+		return;
+	}
+	// everything further than farFieldAccuracy of its size changes its pull slowly, that part is cached per body and only walked every farFieldInterval ticks
+	bool splitFar = farFieldInterval > 1 && farFieldAccuracy < gravityAccuracy;
+	bool refreshFar = splitFar && (refreshAllFar || (!keepFar && (blockTick + phase) % farFieldInterval == 0));
+	for (uint32_t i = 0; i < count && splitFar && !refreshFar; i++) {
+		uint32_t b = group[i];
+		// also refreshed when a body's cache is too old, was found in another group or never found
+		refreshFar = due[b] && (bodies.farTick[b] > blockTick || blockTick - bodies.farTick[b] >= (uint64_t)farFieldInterval);
+	}
+	double gmidx = (gx1 + gx2) * 0.5, gmidy = (gy1 + gy2) * 0.5, ghalfx = (gx2 - gx1) * 0.5, ghalfy = (gy2 - gy1) * 0.5;
+
+	list.near.clear();
+	list.far.clear();
+	list.stack.clear();
+	list.farStack.clear();
+	list.stack.push_back(0);
+	uint64_t visits = 0;
+	// the near field is walked first, far quads it runs into are walked after if the far field is being refreshed
+	while (!list.stack.empty() || !list.farStack.empty()) {
+		bool far = list.stack.empty();
+		std::vector<uint32_t>& stack = far ? list.farStack : list.stack;
+		PointList& points = far ? list.far : list.near;
+		uint32_t at = stack.back();
+		Quad& quad = quadtree[at];
+		stack.pop_back();
+		visits++;
+		// measured from the closest point of the group, so the quad is far enough for every body in it
+		double halfsize = quad.size * 0.5;
+		double dx = std::max(0.0, std::abs(quad.x + halfsize - gmidx) - ghalfx), dy = std::max(0.0, std::abs(quad.y + halfsize - gmidy) - ghalfy);
+		double distance = quad.invsize * (dx + dy);
+		if (!far && splitFar && distance > farFieldAccuracy) {
+			if (refreshFar) {
+				list.farStack.push_back(at);
+			}
+			continue;
+		}
+		if (distance > gravityAccuracy) {
+			points.addQuad(quad);
+			continue;
+		}
+		if (quad.leaf) {
+			points.bodies.insert(points.bodies.end(), quadtreeBodies.begin() + quad.first, quadtreeBodies.begin() + quad.first + quad.count);
+			continue;
+		}
+		for (uint32_t c : quad.children) {
+			if (c != 0) {
+				stack.push_back(c);
+			}
+		}
+	}
+
+	quadVisits.fetch_add(visits, std::memory_order_relaxed);
+	leafWalks.fetch_add(1, std::memory_order_relaxed);
+	if (refreshFar) {
+		farRefreshes.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// near bodies join the list of quads and go through the same kernel, the body itself is skipped for being at distance 0
+	list.near.addBodies();
+	list.far.addBodies();
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t b = group[i];
+		if (!due[b]) {
+			continue;
+		}
+		double ax = 0.0, ay = 0.0;
+		list.near.sum(bx[b], by[b], ax, ay);
+		bodies.accX[b] += ax * G;
+		bodies.accY[b] += ay * G;
+		if (refreshFar) {
+			double fx = 0.0, fy = 0.0;
+			list.far.sum(bx[b], by[b], fx, fy);
+			bodies.farAccX[b] = fx * G;
+			bodies.farAccY[b] = fy * G;
+			bodies.farTick[b] = blockTick;
+		}
+		if (splitFar) {
+			bodies.accX[b] += bodies.farAccX[b];
+			bodies.accY[b] += bodies.farAccY[b];
+		}
+	}
+}
+
+void attractLeaves() {
+	uint64_t pulled = 0;
+	for (size_t i = 0; i < updateGroup.size(); i++) {
+		if (bodies.due[i]) {
+			bodies.accX[i] = 0.0;
+			bodies.accY[i] = 0.0;
+			pulled++;
+		}
+	}
+	pulledBodies += pulled;
+	if (!quadtree[0].used) [[unlikely]] {
+		return;
+	}
+	if (gravitySolver == "fmm") {
+		fmmAttract();
+	} else {
+		parallelFor(leafQuads.size(), [&](size_t from, size_t to) {
+			for (size_t i = from; i < to; i++) {
+				Quad& leaf = quadtree[leafQuads[i]];
+				attractGroup(quadtreeBodies.data() + leaf.first, leaf.count, i);
+			}
+		});
+	}
+	parallelFor(testGroups.size(), [&](size_t from, size_t to) {
+		for (size_t i = from; i < to; i++) {
+			attractGroup(testParticles.data() + testGroups[i][0], testGroups[i][1], leafQuads.size() + i);
+		}
+	});
+}
+
+void printFarFieldError() {
+	size_t count = updateGroup.size();
+	if (farFieldInterval <= 1 || count == 0) {
+		printPreferred("far field isn't cached, farFieldInterval is 1 or less");
+		return;
+	}
+	// gravity on every body with the far field as cached now and found from scratch, leaving the simulation as it was
+	std::vector<double> accX(bodies.accX), accY(bodies.accY), farAccX(bodies.farAccX), farAccY(bodies.farAccY);
+	std::vector<uint64_t> farTick(bodies.farTick);
+	std::vector<uint8_t> due(bodies.due);
+	buildQuadtree();
+	// only bodies whose cache is recent enough to be used count, the others would be refreshed anyway
+	std::vector<uint8_t> cached(count);
+	for (size_t i = 0; i < count; i++) {
+		cached[i] = bodies.farTick[i] <= blockTick && blockTick - bodies.farTick[i] < (uint64_t)farFieldInterval;
+	}
+	std::fill(bodies.due.begin(), bodies.due.begin() + count, 1);
+	keepFar = true;
+	attractLeaves();
+	keepFar = false;
+	std::vector<double> cachedX(bodies.accX.begin(), bodies.accX.begin() + count), cachedY(bodies.accY.begin(), bodies.accY.begin() + count);
+	refreshAllFar = true;
+	attractLeaves();
+	refreshAllFar = false;
+	double maxError = 0.0, sumError = 0.0;
+	size_t used = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (!cached[i]) {
+			continue;
+		}
+		used++;
+		double full = dst(bodies.accX[i], bodies.accY[i]);
+		double error = full == 0.0 ? 0.0 : dst(cachedX[i] - bodies.accX[i], cachedY[i] - bodies.accY[i]) / full;
+		maxError = std::max(maxError, error);
+		sumError += error * error;
+	}
+	bodies.accX.swap(accX);
+	bodies.accY.swap(accY);
+	bodies.farAccX.swap(farAccX);
+	bodies.farAccY.swap(farAccY);
+	bodies.farTick.swap(farTick);
+	bodies.due.swap(due);
+	char out[128];
+	snprintf(out, sizeof(out), "far field cache vs full gravity over %lu of %lu bodies: rms %.3e, max %.3e relative error", (unsigned long)used, (unsigned long)count, used == 0 ? 0.0 : std::sqrt(sumError / used), maxError);
+	printPreferred(out);
+}
+
+void Quad::draw() {
+	sf::RectangleShape quad(sf::Vector2f(size / g_camera.scale, size / g_camera.scale));
+	quad.setPosition(g_camera.w * 0.5 + (x - ownX) / g_camera.scale, g_camera.h * 0.5 + (y - ownY) / g_camera.scale);
+	quad.setFillColor(sf::Color(0, 0, 0, 0));
+	quad.setOutlineColor(sf::Color(0, 0, 255, 255));
+	quad.setOutlineThickness(1);
+	window->draw(quad);
+	for (uint32_t c : children) {
+		if (c != 0) {
+			quadtree[c].draw();
+		}
+	}
+}
+
+void printQuadtreeStats() {
+	char out[192];
+	uint64_t walks = leafWalks.exchange(0), visits = quadVisits.exchange(0), pulled = pulledBodies.exchange(0), refreshes = farRefreshes.exchange(0);
+	snprintf(out, sizeof(out), "%d quads, %lu leaves, %lu test particles, %lu walks, %.1f quads visited per walk, %lu bodies pulled, %lu far field refreshes", quadsConstructed, (unsigned long)leafQuads.size(), (unsigned long)testParticles.size(), (unsigned long)walks, walks == 0 ? 0.0 : (double)visits / walks, (unsigned long)pulled, (unsigned long)refreshes);
+	printPreferred(out);
+}
+
+QuadArena::QuadArena() {
+	reserve(1);
+}
+
+void QuadArena::reserve(uint32_t count) {
+	if (count <= capacity()) [[likely]] {
+		return;
+	}
+	while (capacity() < count) {
+		chunks.push_back(std::make_unique<Quad[]>(chunkSize));
+	}
+	if (debug) [[unlikely]] {
+		printf("Expanded quadtree, new size: %u\n", capacity());
+	}
+}
+
+void QuadArena::release(uint32_t count) {
+	size_t keep = std::max<size_t>((count + chunkSize - 1) / chunkSize, 1);
+	if (keep >= chunks.size()) {
+		return;
+	}
+	chunks.resize(keep);
+	if (debug) [[unlikely]] {
+		printf("Shrunk quadtree, new size: %u\n", capacity());
+	}
+}
+
+// children always come after their parent, so reduce mass and centre of mass from the deepest level up
+// a refit also replaces the quads' cells with the square around the bounding box of their bodies
+static void reduceQuads(bool refit) {
+	const double* bx = bodies.x.data();
+	const double* by = bodies.y.data();
+	const double* bmass = bodies.mass.data();
+	quadBoxes.resize(quadsConstructed);
+	bool quadrupoles = gravityQuadrupoles || gravitySolver == "fmm";
+	for (size_t level = levelStarts.size() - 1; level > 0; level--) {
+		uint32_t from = levelStarts[level - 1];
+		parallelFor(levelStarts[level] - from, [&](size_t lo, size_t hi) {
+			for (size_t i = lo + from; i < hi + from; i++) {
+				Quad& quad = quadtree[i];
+				std::array<double, 4>& box = quadBoxes[i];
+				box = {+INFINITY, +INFINITY, -INFINITY, -INFINITY};
+				double mass = 0.0, comx = 0.0, comy = 0.0;
+				if (quad.leaf) {
+					for (uint32_t j = quad.first; j < quad.first + quad.count; j++) {
+						uint32_t b = quadtreeBodies[j];
+						mass += bmass[b];
+						comx += bmass[b] * bx[b];
+						comy += bmass[b] * by[b];
+						box = {std::min(box[0], bx[b]), std::min(box[1], by[b]), std::max(box[2], bx[b]), std::max(box[3], by[b])};
+					}
+				} else {
+					for (uint32_t c : quad.children) {
+						if (c != 0) {
+							Quad& child = quadtree[c];
+							mass += child.mass;
+							comx += child.mass * child.comx;
+							comy += child.mass * child.comy;
+							std::array<double, 4>& childBox = quadBoxes[c];
+							box = {std::min(box[0], childBox[0]), std::min(box[1], childBox[1]), std::max(box[2], childBox[2]), std::max(box[3], childBox[3])};
+						}
+					}
+				}
+				if (refit) {
+					// bodies stay in the quad they were sorted into, the quad grows or shrinks around them
+					quad.size = std::max(box[2] - box[0], box[3] - box[1]);
+					quad.invsize = 1.0 / quad.size;
+					quad.x = (box[0] + box[2] - quad.size) * 0.5;
+					quad.y = (box[1] + box[3] - quad.size) * 0.5;
+				}
+				quad.mass = mass;
+				quad.comx = comx / mass;
+				quad.comy = comy / mass;
+				if (!quadrupoles) {
+					continue;
+				}
+				// sum of m * (3 s s^T - |s|^2 I) over the contents, s measured from the centre of mass
+				double qxx = 0.0, qxy = 0.0, qyy = 0.0;
+				auto addMoment = [&](double m, double sx, double sy) {
+					sx -= quad.comx;
+					sy -= quad.comy;
+					double s2 = sx * sx + sy * sy;
+					qxx += m * (3.0 * sx * sx - s2);
+					qxy += m * 3.0 * sx * sy;
+					qyy += m * (3.0 * sy * sy - s2);
+				};
+				if (quad.leaf) {
+					for (uint32_t j = quad.first; j < quad.first + quad.count; j++) {
+						uint32_t b = quadtreeBodies[j];
+						addMoment(bmass[b], bx[b], by[b]);
+					}
+				} else {
+					for (uint32_t c : quad.children) {
+						if (c != 0) {
+							Quad& child = quadtree[c];
+							addMoment(child.mass, child.comx, child.comy);
+							qxx += child.qxx;
+							qxy += child.qxy;
+							qyy += child.qyy;
+						}
+					}
+				}
+				quad.qxx = qxx;
+				quad.qxy = qxy;
+				quad.qyy = qyy;
+			}
+		});
+	}
+
+}
+
+// sum of the sizes of the leaves and test particle groups, walks get slower as it grows
+static double treeSpan() {
+	double span = 0.0;
+	for (uint32_t i : leafQuads) {
+		std::array<double, 4>& box = quadBoxes[i];
+		span += std::max(box[2] - box[0], box[3] - box[1]);
+	}
+	for (std::array<uint32_t, 2>& group : testGroups) {
+		double x1 = +INFINITY, y1 = +INFINITY, x2 = -INFINITY, y2 = -INFINITY;
+		for (uint32_t i = group[0]; i < group[0] + group[1]; i++) {
+			uint32_t b = testParticles[i];
+			x1 = std::min(x1, bodies.x[b]);
+			y1 = std::min(y1, bodies.y[b]);
+			x2 = std::max(x2, bodies.x[b]);
+			y2 = std::max(y2, bodies.y[b]);
+		}
+		span += std::max(x2 - x1, y2 - y1);
+	}
+	return span;
+}
+
+// keeps the last build's topology and only updates quad geometry and moments, false if a full build is needed instead
+static bool refitQuadtree() {
+	if (!quadtree[0].used || bodies.generation != builtGeneration) {
+		return false;
+	}
+	reduceQuads(true);
+	return treeSpan() <= builtSpan * quadtreeRefitLimit;
+}
+
+void buildQuadtree() {
+	syncBodies();
+	if (quadtreeRefit && refitQuadtree()) {
+		return;
+	}
+	const double* bmass = bodies.mass.data();
+	// bodies too light to matter only feel the tree, they are grouped by position separately
+	// they are still kicked and drifted in the same passes as everything else, those are flat loops over the store that a batch of their own wouldn't make cheaper
+	double maxMass = 0.0;
+	for (size_t i = 0; i < updateGroup.size(); i++) {
+		maxMass = std::max(maxMass, bmass[i]);
+	}
+	double testMass = maxMass * testParticleMassRatio;
+	quadtreeBodies.clear();
+	testParticles.clear();
+	for (size_t i = 0; i < updateGroup.size(); i++) {
+		(bmass[i] < testMass ? testParticles : quadtreeBodies).push_back(i);
+	}
+	std::array<double, 3> testBounds = boundsOf(testParticles);
+	computeKeys(testParticles, testKeys, testBounds[0], testBounds[1], testBounds[2]);
+	sortMorton(testKeys, testParticles);
+	testGroups.clear();
+	if (!testParticles.empty()) {
+		groupTestParticles(0, testParticles.size());
+	}
+
+	size_t count = quadtreeBodies.size();
+	quadtree[0] = Quad();
+	quadsConstructed = 1;
+	if (count == 0) [[unlikely]] {
+		return;
+	}
+	std::array<double, 3> bounds = boundsOf(quadtreeBodies);
+	quadtree[0].x = rootX = bounds[0];
+	quadtree[0].y = rootY = bounds[1];
+	quadtree[0].size = rootSize = bounds[2];
+	quadtree[0].invsize = 1.0 / quadtree[0].size;
+	computeKeys(quadtreeBodies, mortonKeys, rootX, rootY, rootSize);
+	sortMorton(mortonKeys, quadtreeBodies);
+
+	// every quad is a range of sorted keys, emit the tree one level at a time, a quad's level is where its first and last keys diverge
+	quadtree[0].first = 0;
+	quadtree[0].count = count;
+	levelStarts.clear();
+	leafQuads.clear();
+	uint32_t levelStart = 0, levelEnd = 1;
+	while (levelStart < levelEnd) {
+		levelStarts.push_back(levelStart);
+		splits.resize(levelEnd - levelStart);
+		parallelFor(levelEnd - levelStart, [&](size_t from, size_t to) {
+			for (size_t i = from; i < to; i++) {
+				Quad& quad = quadtree[levelStart + i];
+				std::array<uint32_t, 5>& split = splits[i];
+				quad.used = true;
+				uint64_t lo = mortonKeys[quad.first], hi = mortonKeys[quad.first + quad.count - 1];
+				if (lo == hi || quad.count <= (uint32_t)std::max(quadtreeBucketSize, 1)) {
+					quad.leaf = true;
+					continue;
+				}
+				int level = __builtin_clzll(lo ^ hi) / 2;
+				setCell(quad, lo, level);
+				split[0] = quad.first;
+				split[4] = quad.first + quad.count;
+				for (int c = 1; c < 4; c++) {
+					split[c] = std::lower_bound(mortonKeys.begin() + split[c - 1], mortonKeys.begin() + split[4], c, [&](uint64_t key, int digit) {
+						return keyDigit(key, level) < digit;
+					}) - mortonKeys.begin();
+				}
+			}
+		});
+		uint32_t added = 0;
+		for (uint32_t i = levelStart; i < levelEnd; i++) {
+			if (quadtree[i].leaf) {
+				leafQuads.push_back(i);
+				continue;
+			}
+			std::array<uint32_t, 5>& split = splits[i - levelStart];
+			for (int c = 0; c < 4; c++) {
+				if (split[c + 1] > split[c]) {
+					quadtree[i].children[c] = levelEnd + added;
+					added++;
+				}
+			}
+		}
+		quadtree.reserve(levelEnd + added);
+		parallelFor(levelEnd - levelStart, [&](size_t from, size_t to) {
+			for (size_t i = from; i < to; i++) {
+				Quad& quad = quadtree[levelStart + i];
+				if (quad.leaf) {
+					continue;
+				}
+				int level = __builtin_clzll(mortonKeys[quad.first] ^ mortonKeys[quad.first + quad.count - 1]) / 2;
+				std::array<uint32_t, 5>& split = splits[i];
+				for (int c = 0; c < 4; c++) {
+					if (quad.children[c] == 0) {
+						continue;
+					}
+					Quad& child = quadtree[quad.children[c]];
+					child = Quad();
+					child.first = split[c];
+					child.count = split[c + 1] - split[c];
+					// leaves keep the quadrant they are in, inner quads shrink to their own level when they're split
+					setCell(child, mortonKeys[child.first], level + 1);
+				}
+			}
+		});
+		levelStart = levelEnd;
+		levelEnd += added;
+	}
+	quadsConstructed = levelEnd;
+
+	levelStarts.push_back(levelEnd);
+	reduceQuads(false);
+	builtGeneration = bodies.generation;
+	builtSpan = treeSpan();
+
+	// memory is kept for the biggest tree seen and only given back once the tree stayed small for quadtreeShrinkDelay builds,
+	// so a merge or a stray projectile stretching the root doesn't make every other tick allocate
+	if (std::max((double)quadsConstructed, minQuadtreeSize / quadtreeShrinkThreshold) < quadtree.capacity() * quadtreeShrinkThreshold) [[unlikely]] {
+		smallPeak = std::max(smallPeak, (uint32_t)quadsConstructed);
+		if (++smallBuilds > quadtreeShrinkDelay) {
+			quadtree.release((uint32_t)std::max((double)minQuadtreeSize, smallPeak * extraQuadAllocation));
+			smallBuilds = 0;
+			smallPeak = 0;
+		}
+	} else {
+		smallBuilds = 0;
+		smallPeak = 0;
+	}
+}
+
+}
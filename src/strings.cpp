@@ -1,6 +1,11 @@
 #include "globals.hpp"
+#include "gravity.hpp"
 #include "net.hpp"
+#include "pools.hpp"
+#include "predict.hpp"
+#include "quadtree.hpp"
 #include "strings.hpp"
+#include "threads.hpp"
 #include "types.hpp"
 
 #include <fstream>
@@ -246,6 +251,12 @@ void parseCommand (const string& command) {
 		"lookup <id> - print info about entity ID in argument\n"
 		"count - print amount of entities in existence\n"
 		"showfps - print current framerate\n"
+		"threadstats - print and reset update thread utilization\n"
+		"treestats - print and reset gravity quadtree traversal stats\n"
+		"farerror - print how far gravity with the cached far field is from the full solution\n"
+		"gravitystats - print and reset how long direct and tree gravity take and how often direct is used\n"
+		"predictstats - print and reset how many steps trajectory predictions took\n"
+		"poolstats - print and reset entity pool allocation stats\n"
 		"reset - regenerate the star system");
 		if (isServer) {
 			printPreferred("players - list currently online players\n"
@@ -310,7 +321,7 @@ void parseCommand (const string& command) {
 		size_t id = stoi(id_s);
 		for (Entity* e : updateGroup) {
 			if (e->id == id) {
-				sprintf(out, "Mass %g, radius %g, relative to star 0: x %g, y %g, vX %g, vY %g", e->mass, e->radius, e->x - stars[0]->x, e->y - stars[0]->y, e->velX - stars[0]->velX, e->velY - stars[0]->velY);
+				sprintf(out, "Mass %g, radius %g, relative to star 0: x %g, y %g, vX %g, vY %g", e->mass(), e->radius(), e->x() - stars[0]->x(), e->y() - stars[0]->y(), e->velX() - stars[0]->velX(), e->velY() - stars[0]->velY());
 				printPreferred(string(out));
 				return;
 			}
@@ -362,6 +373,24 @@ void parseCommand (const string& command) {
 	} else if (args[0] == "showfps") {
 		printPreferred(to_string(framerate));
 		return;
+	} else if (args[0] == "threadstats") {
+		printThreadStats();
+		return;
+	} else if (args[0] == "treestats") {
+		printQuadtreeStats();
+		return;
+	} else if (args[0] == "farerror") {
+		printFarFieldError();
+		return;
+	} else if (args[0] == "gravitystats") {
+		printGravityStats();
+		return;
+	} else if (args[0] == "predictstats") {
+		printPredictionStats();
+		return;
+	} else if (args[0] == "poolstats") {
+		printPoolStats();
+		return;
 	}
 	printPreferred("Unknown command.");
 }
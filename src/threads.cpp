@@ -0,0 +1,183 @@
+#include "globals.hpp"
+#include "strings.hpp"
+#include "threads.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace obf {
+
+using threadClock = std::chrono::steady_clock;
+
+static double secondsSince(threadClock::time_point start) {
+	return std::chrono::duration<double>(threadClock::now() - start).count();
+}
+
+ThreadPool::ThreadPool(int threads) {
+	threads = std::max(1, threads);
+	busyTime.resize(threads, 0.0);
+	for (int i = 1; i < threads; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& t : workers) {
+		t.join();
+	}
+}
+
+int ThreadPool::size() {
+	return workers.size() + 1;
+}
+
+void ThreadPool::workerLoop(int index) {
+	uint64_t seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) {
+				return;
+			}
+			seen = generation;
+		}
+		runChunks(index);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--running == 0) {
+				done.notify_one();
+			}
+		}
+	}
+}
+
+void ThreadPool::runChunks(int index) {
+	threadClock::time_point start = threadClock::now();
+	while (true) {
+		size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+		if (chunk >= jobChunks) {
+			break;
+		}
+		size_t from = chunk * jobChunk;
+		(*job)(from, std::min(jobCount, from + jobChunk));
+	}
+	busyTime[index] += secondsSince(start);
+}
+
+void ThreadPool::parallelFor(size_t count, size_t minChunk, const std::function<void(size_t, size_t)>& func) {
+	if (count == 0) {
+		return;
+	}
+	threadClock::time_point start = threadClock::now();
+	// a few chunks per thread so that uneven chunks get balanced out by whoever finishes first
+	size_t chunks = std::clamp(count / std::max(minChunk, (size_t)1), (size_t)1, (size_t)size() * 4);
+	if (workers.empty() || chunks == 1) {
+		func(0, count);
+		busyTime[0] += secondsSince(start);
+	} else {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &func;
+			jobCount = count;
+			jobChunk = (count + chunks - 1) / chunks;
+			jobChunks = (count + jobChunk - 1) / jobChunk;
+			nextChunk.store(0, std::memory_order_relaxed);
+			running = workers.size();
+			generation++;
+		}
+		wake.notify_all();
+		runChunks(0);
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&] { return running == 0; });
+		job = nullptr;
+	}
+	parallelTime += secondsSince(start);
+	jobs++;
+}
+
+std::vector<double> ThreadPool::utilization() {
+	std::vector<double> out(busyTime.size(), 0.0);
+	if (parallelTime > 0.0) {
+		for (size_t i = 0; i < busyTime.size(); i++) {
+			out[i] = busyTime[i] / parallelTime;
+		}
+	}
+	return out;
+}
+
+void ThreadPool::resetStats() {
+	std::fill(busyTime.begin(), busyTime.end(), 0.0);
+	parallelTime = 0.0;
+	jobs = 0;
+}
+
+static ThreadPool* getPool() {
+	int threads = std::max(1, updateThreadCount);
+	if (threads == 1) {
+		return nullptr;
+	}
+	if (!updatePool || updatePool->size() != threads) [[unlikely]] {
+		delete updatePool;
+		updatePool = new ThreadPool(threads);
+		if (debug) [[unlikely]] {
+			printf("Started update thread pool with %d threads\n", threads);
+		}
+	}
+	return updatePool;
+}
+
+void parallelFor(size_t count, const std::function<void(size_t, size_t)>& func) {
+	ThreadPool* pool = count > minThreadEntities ? getPool() : nullptr;
+	if (!pool) {
+		func(0, count);
+		return;
+	}
+	pool->parallelFor(count, minThreadEntities, func);
+}
+
+void parallelTasks(size_t tasks, const std::function<void(size_t)>& func) {
+	ThreadPool* pool = tasks > 1 ? getPool() : nullptr;
+	if (!pool) {
+		for (size_t i = 0; i < tasks; i++) {
+			func(i);
+		}
+		return;
+	}
+	pool->parallelFor(tasks, 1, [&](size_t from, size_t to) {
+		for (size_t i = from; i < to; i++) {
+			func(i);
+		}
+	});
+}
+
+size_t parallelParts(size_t count) {
+	if (updateThreadCount <= 1 || count <= minThreadEntities) {
+		return 1;
+	}
+	return std::min((size_t)updateThreadCount * 4, count / std::max(minThreadEntities, (size_t)1));
+}
+
+void printThreadStats() {
+	if (!updatePool) {
+		printPreferred("Thread pool not running (updateThreadCount is 1 or not enough entities).");
+		return;
+	}
+	char out[128];
+	std::vector<double> util = updatePool->utilization();
+	snprintf(out, sizeof(out), "%d threads, %lu jobs, %.3fms per job", updatePool->size(), (unsigned long)updatePool->jobs, updatePool->jobs == 0 ? 0.0 : updatePool->parallelTime * 1000.0 / updatePool->jobs);
+	printPreferred(out);
+	for (size_t i = 0; i < util.size(); i++) {
+		snprintf(out, sizeof(out), "	worker %lu: %.1f%% busy", (unsigned long)i, util[i] * 100.0);
+		printPreferred(out);
+	}
+	updatePool->resetStats();
+}
+
+}
@@ -107,9 +107,9 @@ void MiscInfoUI::update() {
     info.append("FPS: ").append(std::to_string(framerate))
     .append("\nPing: ").append(std::to_string((int)(lastPing * 1000.0))).append("ms");
     if (lastTrajectoryRef) {
-        info.append("\nDistance: ").append(std::to_string((int64_t)(dst(ownX - lastTrajectoryRef->x, ownY - lastTrajectoryRef->y))));
+        info.append("\nDistance: ").append(std::to_string((int64_t)(dst(ownX - lastTrajectoryRef->x(), ownY - lastTrajectoryRef->y()))));
         if (ownEntity) [[likely]] {
-            info.append("\nVelocity: ").append(std::to_string((int64_t)dst(ownEntity->velX - lastTrajectoryRef->velX, ownEntity->velY - lastTrajectoryRef->velY)));
+            info.append("\nVelocity: ").append(std::to_string((int64_t)dst(ownEntity->velX() - lastTrajectoryRef->velX(), ownEntity->velY() - lastTrajectoryRef->velY())));
         }
     }
     wrapText(info, text, width - padding * 2.f);